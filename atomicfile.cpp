@@ -0,0 +1,37 @@
+#include "atomicfile.h"
+#include <atomic>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+std::string tempFileName(const std::string &filename){
+    static std::atomic<unsigned> counter{0};
+
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+
+    return filename + ".tmp." + std::to_string(pid) + "." + std::to_string(counter++);
+}
+
+int replaceFile(const std::string &temp, const std::string &filename){
+#ifdef _WIN32
+    // rename no sobrescribe en Windows
+    bool ok = MoveFileExA(temp.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    // rename sustituye el archivo de una vez: no hay un momento en el que no exista
+    bool ok = std::rename(temp.c_str(), filename.c_str()) == 0;
+#endif
+
+    if (!ok) {
+        std::remove(temp.c_str());
+        return 1;
+    }
+    return 0;
+}
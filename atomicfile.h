@@ -0,0 +1,20 @@
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+/*
+    Escritura de archivos que pueden estar leyendo o escribiendo otros
+    procesos: se escribe un temporal con nombre único junto al archivo y se
+    renombra encima, así que los demás ven el archivo viejo o el nuevo
+    entero, nunca uno a medias.
+*/
+#include <string>
+
+// Nombre de un temporal junto a filename que no usa ningún otro proceso ni
+// hilo (lleva el PID y un contador del proceso)
+std::string tempFileName(const std::string &filename);
+
+// Renombra temp a filename, sustituyéndolo de forma atómica si ya existe.
+// Si no se puede, borra temp y devuelve 1
+int replaceFile(const std::string &temp, const std::string &filename);
+
+#endif // ATOMICFILE_H
@@ -0,0 +1,128 @@
+/*
+    Medida del coste de las estadísticas en cada núcleo del intérprete.
+
+    Ejecuta un bucle fijo (cargas, escrituras, aritmética y saltos) con cada
+    núcleo y cada nivel de StatsLevel, y muestra los millones de
+    instrucciones por segundo. No depende de Qt.
+
+    Uso: Emulador-RISC-V-benchmark [instrucciones]
+*/
+#include "cpu.h"
+#include "memory.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+static const uint32_t MEMORY_SIZE = 0x100000;
+static const uint32_t ROM_START = 0x1000;
+static const uint32_t BURST = 1000000;
+
+// Codificación de las instrucciones que usa el programa de prueba
+static uint32_t encodeR(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode){
+    return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+static uint32_t encodeI(int32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode){
+    return (uint32_t)(imm & 0xFFF) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+static uint32_t encodeS(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3){
+    return (uint32_t)((imm >> 5) & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (uint32_t)(imm & 0x1F) << 7 | 0x23;
+}
+static uint32_t encodeB(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3){
+    return (uint32_t)((imm >> 12) & 0x1) << 31 | (uint32_t)((imm >> 5) & 0x3F) << 25 | rs2 << 20 | rs1 << 15
+           | funct3 << 12 | (uint32_t)((imm >> 1) & 0xF) << 8 | (uint32_t)((imm >> 11) & 0x1) << 7 | 0x63;
+}
+static uint32_t encodeJ(int32_t imm, uint32_t rd){
+    return (uint32_t)((imm >> 20) & 0x1) << 31 | (uint32_t)((imm >> 1) & 0x3FF) << 21 | (uint32_t)((imm >> 11) & 0x1) << 20
+           | (uint32_t)((imm >> 12) & 0xFF) << 12 | rd << 7 | 0x6F;
+}
+
+// Recorre 256 palabras a partir de 0x10000 leyendo, operando y escribiendo
+// cada una, sin terminar nunca
+static const uint32_t program[] = {
+    0x00010000 | 5 << 7 | 0x37,             //       lui  x5, 0x10
+    encodeI(0, 0, 0, 6, 0x13),              //       addi x6, x0, 0
+    encodeI(256, 0, 0, 7, 0x13),            //       addi x7, x0, 256
+    encodeI(2, 6, 1, 8, 0x13),              // loop: slli x8, x6, 2
+    encodeR(0, 8, 5, 0, 9, 0x33),           //       add  x9, x5, x8
+    encodeI(0, 9, 2, 10, 0x03),             //       lw   x10, 0(x9)
+    encodeR(0, 6, 10, 0, 10, 0x33),         //       add  x10, x10, x6
+    encodeI(0x55, 10, 4, 10, 0x13),         //       xori x10, x10, 0x55
+    encodeS(0, 10, 9, 2),                   //       sw   x10, 0(x9)
+    encodeR(0, 7, 6, 3, 11, 0x33),          //       sltu x11, x6, x7
+    encodeR(0, 11, 12, 0, 12, 0x33),        //       add  x12, x12, x11
+    encodeI(1, 6, 0, 6, 0x13),              //       addi x6, x6, 1
+    encodeI(255, 6, 7, 6, 0x13),            //       andi x6, x6, 255
+    encodeB(-40, 0, 6, 1),                  //       bne  x6, x0, loop
+    encodeJ(-44, 0),                        //       jal  x0, loop
+};
+
+// Ejecuta total instrucciones y devuelve los segundos que ha tardado
+static double measure(Memory &ram, CPU::Core core, StatsLevel stats, uint32_t total){
+    ram.reset();
+
+    std::unique_ptr<CPU> cpu(new CPU(&ram));
+    ram.pICache = &cpu->icache;
+    cpu->reset();
+
+    uint32_t addr = ROM_START;
+    for (uint32_t word : program) {
+        for (int i = 0; i < 4; i++)
+            ram.writeByte(addr++, word >> (8 * i));
+    }
+    cpu->icache.setRegion(ROM_START, addr - ROM_START);
+
+    cpu->core = core;
+    cpu->stats = stats;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (cpu->cycles < total) {
+        uint32_t n = total - cpu->cycles;
+        cpu->runInstructions(n < BURST ? n : BURST);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    ram.pICache = nullptr;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[]){
+    uint32_t total = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000000;
+
+    Memory ram(MEMORY_SIZE);
+    ram.iRomStartAddr = ROM_START;
+
+    const struct { CPU::Core core; const char *name; } cores[] = {
+        { CPU::Core::Classic,  "classic" },
+        { CPU::Core::Threaded, "threaded" },
+        { CPU::Core::Block,    "block" },
+        { CPU::Core::Jit,      "jit" },
+    };
+    const struct { StatsLevel level; const char *name; } levels[] = {
+        { StatsLevel::None,      "none" },
+        { StatsLevel::PerType,   "per-type" },
+        { StatsLevel::PerOpcode, "per-opcode" },
+        { StatsLevel::PerPc,     "per-pc" },
+    };
+
+    std::cout << "Instrucciones por medida: " << total << std::endl;
+    std::cout << std::left << std::setw(10) << "núcleo";
+    for (const auto &level : levels)
+        std::cout << std::right << std::setw(12) << level.name;
+    std::cout << "   (M instr/s)" << std::endl;
+
+    for (const auto &core : cores) {
+        std::cout << std::left << std::setw(10) << core.name;
+        for (const auto &level : levels) {
+            double seconds = measure(ram, core.core, level.level, total);
+            std::cout << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+                      << total / seconds / 1e6 << std::flush;
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
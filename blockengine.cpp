@@ -0,0 +1,427 @@
+/*
+    MOTOR DE BLOQUES BÁSICOS.
+
+    Cada bloque se traduce una vez a partir de la caché de instrucciones
+    de la CPU. Las funciones de las operaciones reciben los operandos ya
+    resueltos (LUI y AUIPC se convierten en cargas de una constante), y al
+    terminar un bloque se salta directamente al sucesor enlazado sin pasar
+    por la búsqueda.
+
+    La semántica de cada instrucción es la misma que la de su función en
+    cpu.cpp. No se genera desensamblado.
+*/
+
+#include "blockengine.h"
+#include "cpu.h"
+#include "jit.h"
+
+//===================================================
+//          OPERACIONES DEL CUERPO DEL BLOQUE
+//===================================================
+
+#define X cpu.registers
+
+// R format
+static void opADD(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] + X[op.rs2]; }
+static void opSUB(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] - X[op.rs2]; }
+static void opXOR(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] ^ X[op.rs2]; }
+static void opOR(CPU &cpu, const BlockOp &op)   { X[op.rd] = X[op.rs1] | X[op.rs2]; }
+static void opAND(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] & X[op.rs2]; }
+static void opSLL(CPU &cpu, const BlockOp &op)  { X[op.rd] = static_cast<uint32_t>(X[op.rs1]) << (X[op.rs2] & 0b11111); }
+static void opSRL(CPU &cpu, const BlockOp &op)  { X[op.rd] = static_cast<uint32_t>(X[op.rs1]) >> (X[op.rs2] & 0b11111); }
+static void opSRA(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] >> (X[op.rs2] & 0b11111); }
+static void opSLT(CPU &cpu, const BlockOp &op)  { X[op.rd] = (X[op.rs1] < X[op.rs2]) ? 1 : 0; }
+static void opSLTU(CPU &cpu, const BlockOp &op) { X[op.rd] = (static_cast<uint32_t>(X[op.rs1]) < static_cast<uint32_t>(X[op.rs2])) ? 1 : 0; }
+
+// I format
+static void opADDI(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] + op.inmediate; }
+static void opXORI(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] ^ op.inmediate; }
+static void opORI(CPU &cpu, const BlockOp &op)   { X[op.rd] = X[op.rs1] | op.inmediate; }
+static void opANDI(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] & op.inmediate; }
+static void opSLLI(CPU &cpu, const BlockOp &op)  { X[op.rd] = static_cast<uint32_t>(X[op.rs1]) << (static_cast<uint32_t>(op.inmediate) & 0b11111); }
+static void opSRLI(CPU &cpu, const BlockOp &op)  { X[op.rd] = static_cast<uint32_t>(X[op.rs1]) >> (static_cast<uint32_t>(op.inmediate) & 0b11111); }
+static void opSRAI(CPU &cpu, const BlockOp &op)  { X[op.rd] = X[op.rs1] >> (op.inmediate & 0b11111); }
+static void opSLTI(CPU &cpu, const BlockOp &op)  { X[op.rd] = (X[op.rs1] < op.inmediate) ? 1 : 0; }
+static void opSLTIU(CPU &cpu, const BlockOp &op) { X[op.rd] = (static_cast<uint32_t>(X[op.rs1]) < static_cast<uint32_t>(op.inmediate)) ? 1 : 0; }
+
+static void opLB(CPU &cpu, const BlockOp &op)  { X[op.rd] = static_cast<int8_t>(cpu.ram->readByte(X[op.rs1] + op.inmediate)); }
+static void opLH(CPU &cpu, const BlockOp &op)  { X[op.rd] = static_cast<int16_t>(cpu.ram->readHalf(X[op.rs1] + op.inmediate)); }
+static void opLW(CPU &cpu, const BlockOp &op)  { X[op.rd] = cpu.ram->readWord(X[op.rs1] + op.inmediate); }
+static void opLBU(CPU &cpu, const BlockOp &op) { X[op.rd] = cpu.ram->readByte(X[op.rs1] + op.inmediate) & 0xFF; }
+static void opLHU(CPU &cpu, const BlockOp &op) { X[op.rd] = cpu.ram->readHalf(X[op.rs1] + op.inmediate); }
+
+static void opEBREAK(CPU &cpu, const BlockOp &) { cpu.bEbreak = true; }
+static void opNOP(CPU &, const BlockOp &) {}
+
+// Codificación no válida: el inmediato guarda su dirección
+static void opILLEGAL(CPU &cpu, const BlockOp &op) { cpu.illegalInstruction(op.inmediate); }
+
+// S format
+static void opSB(CPU &cpu, const BlockOp &op) { cpu.ram->writeByte(X[op.rs1] + op.inmediate, X[op.rs2] & 0xFF); }
+static void opSH(CPU &cpu, const BlockOp &op) { cpu.ram->writeHalf(X[op.rs1] + op.inmediate, X[op.rs2] & 0xFFFF); }
+static void opSW(CPU &cpu, const BlockOp &op) { cpu.ram->writeWord(X[op.rs1] + op.inmediate, X[op.rs2]); }
+
+// LUI y AUIPC: el valor se calcula al traducir
+static void opLI(CPU &cpu, const BlockOp &op) { X[op.rd] = op.inmediate; }
+
+//===================================================
+//              SALTOS DE FINAL DE BLOQUE
+//===================================================
+
+// B format
+static uint32_t exitBEQ(CPU &cpu, const BlockOp &op, uint32_t pc)  { return pc + ((X[op.rs1] == X[op.rs2]) ? op.inmediate : 4); }
+static uint32_t exitBNE(CPU &cpu, const BlockOp &op, uint32_t pc)  { return pc + ((X[op.rs1] != X[op.rs2]) ? op.inmediate : 4); }
+static uint32_t exitBLT(CPU &cpu, const BlockOp &op, uint32_t pc)  { return pc + ((X[op.rs1] < X[op.rs2]) ? op.inmediate : 4); }
+static uint32_t exitBGE(CPU &cpu, const BlockOp &op, uint32_t pc)  { return pc + ((X[op.rs1] >= X[op.rs2]) ? op.inmediate : 4); }
+static uint32_t exitBLTU(CPU &cpu, const BlockOp &op, uint32_t pc) { return pc + ((static_cast<uint32_t>(X[op.rs1]) < static_cast<uint32_t>(X[op.rs2])) ? op.inmediate : 4); }
+static uint32_t exitBGEU(CPU &cpu, const BlockOp &op, uint32_t pc) { return pc + ((static_cast<uint32_t>(X[op.rs1]) >= static_cast<uint32_t>(X[op.rs2])) ? op.inmediate : 4); }
+
+// J format
+static uint32_t exitJAL(CPU &cpu, const BlockOp &op, uint32_t pc) {
+    if (op.rd != 0)
+        X[op.rd] = pc + 4;
+    return pc + op.inmediate;
+}
+
+static uint32_t exitJALR(CPU &cpu, const BlockOp &op, uint32_t pc) {
+    uint32_t target = X[op.rs1] + op.inmediate;
+    if (op.rd != 0)
+        X[op.rd] = pc + 4;
+    return target;
+}
+
+#undef X
+
+// Funciones del cuerpo, indexadas por Operation. Los saltos no están
+static const BlockHandler bodyHandlers[] = {
+    opADD, opSUB, opXOR, opOR, opAND, opSLL, opSRL, opSRA, opSLT, opSLTU,
+    opADDI, opXORI, opORI, opANDI,
+    opSLLI, opSRLI, opSRAI, opSLTI, opSLTIU,
+    opLB, opLH, opLW, opLBU, opLHU,
+    nullptr,            // JALR
+    opNOP, opEBREAK,    // ECALL, EBREAK
+    opSB, opSH, opSW,
+    nullptr, nullptr, nullptr, nullptr, nullptr,
+    nullptr,            // BGEU
+    nullptr,            // JAL
+    opLI, opLI,         // LUI, AUIPC
+    opILLEGAL           // NOP (FENCE se cambia por opNOP al traducir)
+};
+
+// Devuelve la función de salto de la operación, o nullptr si no termina un bloque
+static BlockExit exitHandler(uint8_t op){
+    switch (op)
+    {
+    case Operation::BEQ:  return exitBEQ;
+    case Operation::BNE:  return exitBNE;
+    case Operation::BLT:  return exitBLT;
+    case Operation::BGE:  return exitBGE;
+    case Operation::BLTU: return exitBLTU;
+    case Operation::BGEU: return exitBGEU;
+    case Operation::JAL:  return exitJAL;
+    case Operation::JALR: return exitJALR;
+    default:              return nullptr;
+    }
+}
+
+//===================================================
+//                      MOTOR
+//===================================================
+
+uint32_t BlockEngine::run(CPU &cpu, uint32_t n){
+    uint32_t executed = 0;
+    uint32_t lastPc = 0;        // Dirección de la última instrucción ejecutada en un bloque
+    bool bLastInBlock = false;
+    Block *block = nullptr;
+
+    if (bUseJit && jit == nullptr && JitCompiler::available())
+        jit.reset(new JitCompiler());
+
+    while (executed < n) {
+        // Si se ha modificado código ya decodificado, los bloques dejan de ser válidos
+        if (generation != cpu.icache.generation) {
+            flush(cpu);
+            block = nullptr;
+        }
+
+        // El código que ya ha compilado el JIT se instala entre bloques
+        if (jit != nullptr && jit->hasResults())
+            installCompiled(cpu);
+
+        if (block == nullptr) {
+            block = lookup(cpu, cpu.pc);
+
+            if (block == nullptr) {
+                // Fuera de la ROM no hay bloques: se ejecuta una sola instrucción
+                executed += cpu.runThreaded(1);
+                bLastInBlock = false;   // runThreaded ya deja el IR
+
+                if (cpu.ram->bWatchHit || cpu.bEbreak || cpu.trap != Trap::None)
+                    break;
+                continue;
+            }
+        }
+
+        // Cuerpo del bloque, sin pasarse de las instrucciones pedidas
+        uint32_t nBody = block->ops.size();
+        uint32_t limit = (n - executed < nBody) ? n - executed : nBody;
+        uint32_t i = 0;
+        bool stopped = false;
+        bool bNativeExit = false;   // El código nativo ya ha ejecutado el salto final
+        uint32_t nativePc = 0;
+
+        if (block->native != nullptr && n - executed >= block->nInsts) {
+            // Código nativo: solo si quedan instrucciones para el bloque entero
+            JitContext ctx = { cpu.registers, cpu.ram, &cpu.icache, generation, 0 };
+            nativePc = block->native(&ctx);
+
+            if (ctx.executed == block->nInsts) {
+                i = nBody;
+                bNativeExit = (block->exit != nullptr);
+            } else {
+                i = ctx.executed;
+                stopped = true;
+            }
+        } else {
+            while (i < limit) {
+                const BlockOp &op = block->ops[i++];
+                op.handler(cpu, op);
+
+                // Una escritura puede tocar la dirección vigilada o el propio código,
+                // y un acceso a memoria o una instrucción no válida pueden dar una excepción
+                if (op.mayStop && (cpu.ram->bWatchHit || cpu.bEbreak || cpu.trap != Trap::None ||
+                                   cpu.icache.generation != generation)) {
+                    stopped = true;
+                    break;
+                }
+            }
+
+            // Los bloques que se ejecutan muchas veces se mandan a compilar
+            if (jit != nullptr && !block->bQueued && ++block->hits >= JitCompiler::HOT_THRESHOLD) {
+                jit->request(*block, epoch);
+                block->bQueued = true;
+            }
+        }
+
+        executed += i;
+        cpu.cycles += i;
+
+        // Estadísticas: si se ha ejecutado el cuerpo entero se suman las ya
+        // calculadas al traducir; si no (o si se cuentan por PC), instrucción a instrucción
+        if (cpu.stats != StatsLevel::None) {
+            if (i == nBody && cpu.stats != StatsLevel::PerPc) {
+                for (const BlockCount &count : block->counts) {
+                    if (count.op != Operation::NOP)
+                        cpu.ciclosTipo[count.tipo] += count.n;
+                    if (cpu.stats == StatsLevel::PerOpcode)
+                        cpu.ciclosTotales[count.op] += count.n;
+                }
+            } else {
+                dispatchStats(cpu.stats, [&](auto policy) {
+                    for (uint32_t k = 0; k < i; k++) {
+                        const BlockOp &op = block->ops[k];
+                        decltype(policy)::count(cpu, block->startPc + 4 * k, op.op, op.tipo);
+                    }
+                });
+            }
+        }
+
+        if (i > 0) {
+            lastPc = block->startPc + 4 * (i - 1);
+            bLastInBlock = true;
+        }
+
+        if (stopped || i < nBody) {
+            // El bloque no se ha completado: se deja el PC en la siguiente
+            // instrucción, salvo si la última no es válida, que se queda en
+            // ella como en el threaded (cuenta como ejecutada)
+            cpu.pc = block->startPc + 4 * i;
+            if (cpu.trap == Trap::IllegalInstruction && i > 0 && cpu.trapPc == cpu.pc - 4)
+                cpu.pc -= 4;
+            block = nullptr;
+
+            if (cpu.ram->bWatchHit || cpu.bEbreak || cpu.trap != Trap::None)
+                break;
+            continue;
+        }
+
+        uint32_t exitPc = block->startPc + 4 * nBody;
+
+        if (block->exit == nullptr) {
+            cpu.pc = exitPc;    // Bloque cortado: sigue en la siguiente instrucción
+        } else {
+            if (executed == n) {
+                cpu.pc = exitPc;    // El salto queda para la siguiente llamada
+                break;
+            }
+
+            const BlockOp &op = block->exitOp;
+            if (cpu.stats != StatsLevel::None)
+                dispatchStats(cpu.stats, [&](auto policy) {
+                    decltype(policy)::count(cpu, exitPc, op.op, op.tipo);
+                });
+
+            cpu.pc = bNativeExit ? nativePc : block->exit(cpu, op, exitPc);
+            lastPc = exitPc;
+            bLastInBlock = true;
+            executed++;
+            cpu.cycles++;
+        }
+
+        // Encadenamiento con el siguiente bloque
+        Block *next;
+        if (cpu.pc == block->succPc[0] && block->succ[0] != nullptr) {
+            next = block->succ[0];
+        } else if (cpu.pc == block->succPc[1] && block->succ[1] != nullptr) {
+            next = block->succ[1];
+        } else {
+            next = lookup(cpu, cpu.pc);
+
+            if (cpu.pc == block->succPc[1]) {
+                block->succ[1] = next;
+            } else {
+                // En JALR el destino cambia: se guarda el último
+                block->succPc[0] = cpu.pc;
+                block->succ[0] = next;
+            }
+        }
+
+        block = next;
+    }
+
+    // IR de la última instrucción, para la interfaz
+    if (bLastInBlock) {
+        PredecodedInst scratch;
+        cpu.ir = cpu.fetchDecoded(lastPc, &scratch)->ir;
+    }
+
+    return executed;
+}
+
+BlockEngine::BlockEngine() {}
+
+// Aquí ya se conoce JitCompiler para poder destruirlo
+BlockEngine::~BlockEngine() {}
+
+void BlockEngine::flush(CPU &cpu){
+    blocks.clear();
+    blockMap.assign(cpu.icache.entries.size(), nullptr);
+    generation = cpu.icache.generation;
+
+    // El código de los bloques descartados ya no se puede usar, y lo que
+    // esté compilándose se descartará al recogerlo
+    epoch++;
+    if (jit != nullptr)
+        jit->releaseAll();
+}
+
+// Instala el código nativo en los bloques para los que se pidió
+void BlockEngine::installCompiled(CPU &cpu){
+    for (const JitCompiler::Result &result : jit->takeResults()) {
+        Block *block = nullptr;
+        if (result.epoch == epoch && cpu.icache.lookup(result.startPc) != nullptr)
+            block = blockMap[(result.startPc - cpu.icache.iStart) >> 2];
+
+        if (block != nullptr && block->native == nullptr) {
+            block->native = reinterpret_cast<JitFunction>(result.code.memory);
+            jit->keep(result.code);
+        } else {
+            JitCompiler::release(result.code);
+        }
+    }
+}
+
+// Devuelve el bloque que empieza en pc, traduciéndolo si hace falta.
+// Devuelve nullptr si pc está fuera de la ROM
+Block* BlockEngine::lookup(CPU &cpu, uint32_t pc){
+    if (cpu.icache.lookup(pc) == nullptr)
+        return nullptr;
+
+    Block *&slot = blockMap[(pc - cpu.icache.iStart) >> 2];
+    if (slot == nullptr)
+        slot = translate(cpu, pc);
+
+    return slot;
+}
+
+// Traduce el bloque que empieza en pc
+Block* BlockEngine::translate(CPU &cpu, uint32_t pc){
+    Block *block = new Block();
+    blocks.emplace_back(block);
+
+    block->startPc = pc;
+    block->exit = nullptr;
+    block->succPc[0] = block->succPc[1] = 0xFFFFFFFF;
+    block->succ[0] = block->succ[1] = nullptr;
+    block->hits = 0;
+    block->bQueued = false;
+    block->native = nullptr;
+
+    PredecodedInst scratch;
+    uint32_t addr = pc;
+
+    while (block->ops.size() < MAX_BLOCK_SIZE && cpu.icache.lookup(addr) != nullptr) {
+        const PredecodedInst *inst = cpu.fetchDecoded(addr, &scratch);
+
+        BlockOp op = {};
+        op.op = inst->op;
+        op.tipo = inst->tipo;
+        op.inmediate = inst->inmediate;
+        op.rd = inst->rd;
+        op.rs1 = inst->rs1;
+        op.rs2 = inst->rs2;
+
+        BlockExit exit = exitHandler(inst->op);
+        if (exit != nullptr) {
+            block->exitOp = op;
+            block->exit = exit;
+
+            if (inst->op != Operation::JALR)
+                block->succPc[0] = addr + inst->inmediate;  // Destino del salto
+            if (inst->tipo == 3)
+                block->succPc[1] = addr + 4;                // No se salta
+            break;
+        }
+
+        if (inst->op == Operation::LUI)
+            op.inmediate = static_cast<uint32_t>(inst->inmediate) << 12;
+        else if (inst->op == Operation::AUIPC)
+            op.inmediate = addr + (static_cast<uint32_t>(inst->inmediate) << 12);
+
+        op.handler = bodyHandlers[inst->op];
+        op.mayStop = (inst->op >= Operation::LB && inst->op <= Operation::LHU) ||
+                     inst->op == Operation::SB || inst->op == Operation::SH || inst->op == Operation::SW ||
+                     inst->op == Operation::EBREAK;
+
+        if (inst->op == Operation::NOP) {
+            if (isFence(inst->ir)) {
+                op.handler = opNOP;     // FENCE
+            } else {
+                op.inmediate = addr;
+                op.mayStop = 1;
+            }
+        }
+
+        block->ops.push_back(op);
+        addr += 4;
+    }
+
+    if (block->exit == nullptr)
+        block->succPc[1] = addr;    // Bloque cortado: sigue en la siguiente instrucción
+
+    block->nInsts = block->ops.size() + (block->exit != nullptr ? 1 : 0);
+
+    // Cuántas veces aparece cada operación en el cuerpo
+    for (const BlockOp &op : block->ops) {
+        auto it = block->counts.begin();
+        while (it != block->counts.end() && it->op != op.op)
+            ++it;
+
+        if (it == block->counts.end())
+            block->counts.push_back({op.op, op.tipo, 1});
+        else
+            it->n++;
+    }
+
+    return block;
+}
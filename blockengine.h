@@ -0,0 +1,99 @@
+#ifndef BLOCKENGINE_H
+#define BLOCKENGINE_H
+
+/*
+    Motor de bloques básicos. Divide el programa en tramos de instrucciones
+    seguidas que terminan en un salto (BEQ..BGEU, JAL o JALR), traduce cada
+    tramo una sola vez a un array de operaciones con su función y sus
+    operandos ya resueltos, y enlaza cada bloque con los bloques a los que
+    salta para no tener que volver a buscarlos.
+*/
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CPU;
+class JitCompiler;
+struct BlockOp;
+struct JitContext;
+
+// Función de una instrucción del cuerpo del bloque
+typedef void (*BlockHandler)(CPU &cpu, const BlockOp &op);
+
+// Función del salto final del bloque. Devuelve el nuevo PC
+typedef uint32_t (*BlockExit)(CPU &cpu, const BlockOp &op, uint32_t pc);
+
+// Código nativo de un bloque generado por el JIT. Devuelve el nuevo PC
+typedef uint32_t (*JitFunction)(JitContext *ctx);
+
+struct BlockOp
+{
+    BlockHandler handler;
+    int32_t inmediate;
+    uint8_t rd, rs1, rs2;
+    uint8_t op;         // Operation, para las estadísticas
+    uint8_t tipo;       // Formato, para las estadísticas
+    uint8_t mayStop;    // Después de un acceso a memoria, un EBREAK o una instrucción no válida hay que comprobar si se debe parar
+};
+
+// Número de veces que aparece una operación en un bloque
+struct BlockCount
+{
+    uint8_t op;
+    uint8_t tipo;
+    uint32_t n;
+};
+
+struct Block
+{
+    uint32_t startPc;
+    uint32_t nInsts;            // Número de instrucciones, incluido el salto final
+
+    std::vector<BlockOp> ops;   // Cuerpo del bloque, sin el salto
+    BlockOp exitOp;
+    BlockExit exit;             // nullptr si el bloque se ha cortado sin llegar a un salto
+
+    std::vector<BlockCount> counts;     // Estadísticas del cuerpo completo
+
+    // Bloques sucesores ya enlazados. En los saltos condicionales [0] es el
+    // destino y [1] la siguiente instrucción; en JALR [0] guarda el último destino
+    uint32_t succPc[2];
+    Block *succ[2];
+
+    // Compilación con el JIT
+    uint32_t hits;              // Veces que se ha ejecutado interpretado
+    bool bQueued;               // Ya se ha pedido compilarlo
+    JitFunction native;         // nullptr hasta que se instala el código
+};
+
+class BlockEngine {
+public:
+    BlockEngine();
+    ~BlockEngine();
+
+    // Si está activo, los bloques más ejecutados se compilan a código nativo
+    bool bUseJit = false;
+
+    // Ejecuta hasta n instrucciones. Para antes si se escribe en la dirección
+    // vigilada de la memoria o salta una excepción. Devuelve las instrucciones ejecutadas
+    uint32_t run(CPU &cpu, uint32_t n);
+
+    // Descarta todos los bloques traducidos
+    void flush(CPU &cpu);
+
+    static const uint32_t MAX_BLOCK_SIZE = 64;
+
+private:
+    std::vector<std::unique_ptr<Block>> blocks;
+    std::vector<Block*> blockMap;   // Bloque que empieza en cada palabra de la ROM
+    uint32_t generation = 0xFFFFFFFF;
+    uint32_t epoch = 0;             // Se incrementa al descartar los bloques
+
+    std::unique_ptr<JitCompiler> jit;
+    void installCompiled(CPU &cpu);
+
+    Block* lookup(CPU &cpu, uint32_t pc);
+    Block* translate(CPU &cpu, uint32_t pc);
+};
+
+#endif // BLOCKENGINE_H
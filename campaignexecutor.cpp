@@ -0,0 +1,553 @@
+#include "campaignexecutor.h"
+#include "campaigngenerator.h"
+#include "liveness.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+// Por debajo de esto, comprobar el hash cuesta más que lo que se ahorra
+static const uint32_t MIN_HASH_INTERVAL = 256;
+
+// Una muestra más pequeña no se da por buena aunque el margen ya lo sea
+static const uint32_t MIN_SAMPLE = 100;
+
+// Resultado de una posición de la muestra que todavía no ha terminado
+static const uint8_t SAMPLE_PENDING = 0xFF;
+
+// Valor de la normal tal que P(|Z| > z) = 1 - confidence, por bisección
+static double confidenceZ(double confidence){
+    double low = 0, high = 40;
+    for (int i = 0; i < 100; i++) {
+        double middle = (low + high) / 2;
+        if (std::erfc(middle / std::sqrt(2.0)) > 1 - confidence)
+            low = middle;
+        else
+            high = middle;
+    }
+    return (low + high) / 2;
+}
+
+// Semiancho del intervalo de Wilson, con la corrección por población finita
+static double wilsonMargin(uint32_t hits, uint32_t n, uint64_t population, double z){
+    if (n == 0)
+        return 1;
+
+    double p = static_cast<double>(hits) / n;
+    double margin = z / (1 + z * z / n) * std::sqrt(p * (1 - p) / n + z * z / (4.0 * n * n));
+
+    if (population > 1 && n <= population)
+        margin *= std::sqrt(static_cast<double>(population - n) / (population - 1));
+    return margin;
+}
+
+static inline uint64_t packRange(uint32_t begin, uint32_t end){
+    return (static_cast<uint64_t>(begin) << 32) | end;
+}
+
+CampaignExecutor::CampaignExecutor(){
+    for (auto &counter : counters)
+        counter = 0;
+}
+
+CampaignExecutor::~CampaignExecutor(){
+    cancel();
+}
+
+int CampaignExecutor::start(const Computer &model, const Campaign &campaign, const CampaignSettings &settings){
+    if (bRunning)
+        return 1;
+
+    if (controller.joinable())
+        controller.join();
+
+    this->campaign = campaign;
+    this->settings = settings;
+
+    unsigned nThreads = settings.threads;
+    if (nThreads == 0)
+        nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0)
+        nThreads = 1;
+
+    // Cada hilo con su ordenador, configurado como el de la interfaz
+    workers.clear();
+    for (unsigned i = 0; i < nThreads; i++) {
+        std::unique_ptr<Worker> worker(new Worker);
+        worker->computer.reset(new Computer(model.ram.iMemorySize));
+
+        Computer &computer = *worker->computer;
+        computer.ram.iRomStartAddr = model.ram.iRomStartAddr;
+        computer.cpu.core = model.cpu.core;
+        computer.cpu.stats = StatsLevel::None;
+        computer.cpu.history.setDepth(0);
+        computer.stop.finishAddr = model.stop.finishAddr;
+
+        workers.push_back(std::move(worker));
+    }
+
+    vResults.assign(campaign.injections.size(), DUE);
+    iCompleted = 0;
+    for (auto &counter : counters)
+        counter = 0;
+
+    bCancel = false;
+    bConverged = false;
+    bFinished = false;
+    bRunning = true;
+
+    controller = std::thread(&CampaignExecutor::run, this);
+
+    return 0;
+}
+
+void CampaignExecutor::cancel(){
+    bCancel = true;
+
+    if (controller.joinable())
+        controller.join();
+}
+
+// Hilo principal de la campaña: ejecución de referencia, reparto y espera
+void CampaignExecutor::run(){
+    const std::string &program = campaign.programPath;
+
+    for (auto &worker : workers) {
+        worker->computer->reset();
+        if (worker->computer->LoadProgram(program) != 0) {
+            std::cerr << "No se ha podido cargar el programa de la campaña" << std::endl;
+            bRunning = false;
+            bFinished.store(true, std::memory_order_release);
+            return;
+        }
+    }
+
+    // Puntos de control en la ejecución de referencia, con el primer ordenador
+    uint32_t expected = campaign.expectedInstructions;
+    uint32_t interval = 0;
+    if (settings.checkpointCount > 0)
+        interval = (expected > settings.checkpointCount) ? expected / settings.checkpointCount : 1;
+
+    // Y los hashes del estado, para cortar las ejecuciones que vuelven a él
+    uint32_t hashInterval = 0;
+    if (settings.hashPointCount > 0)
+        hashInterval = std::max(expected / settings.hashPointCount, MIN_HASH_INTERVAL);
+
+    checkpoints.record(*workers[0]->computer, interval, expected, hashInterval);
+
+    planRuns();
+
+    std::vector<std::thread> threads;
+    if (sampling()) {
+        prepareSample();
+        for (size_t i = 0; i < workers.size(); i++)
+            threads.emplace_back(&CampaignExecutor::runSampler, this, i);
+    } else {
+        // Un tramo contiguo de inyecciones para cada hilo
+        uint32_t nRuns = vRuns.size();
+        uint32_t nWorkers = workers.size();
+        for (uint32_t i = 0; i < nWorkers; i++) {
+            uint32_t begin = static_cast<uint64_t>(nRuns) * i / nWorkers;
+            uint32_t end = static_cast<uint64_t>(nRuns) * (i + 1) / nWorkers;
+            workers[i]->range = packRange(begin, end);
+        }
+
+        for (size_t i = 0; i < workers.size(); i++)
+            threads.emplace_back(&CampaignExecutor::runWorker, this, i);
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    if (sampling()) {
+        // Los resultados son los de la parte de la muestra ya contada
+        countSamples();
+        vResults.resize(iCounted);
+        for (uint32_t i = 0; i < iCounted; i++)
+            vResults[i] = pSampleResults[i].load(std::memory_order_relaxed);
+
+        pSampleResults.reset();
+        pRunResults.reset();
+    } else {
+        // Las que no se han ejecutado tienen el resultado de su representante
+        for (uint32_t i = 0; i < vRepresentative.size(); i++) {
+            uint32_t rep = vRepresentative[i];
+            if (rep == DEAD_INJECTION)
+                vResults[i] = NO_EFFECT;
+            else if (rep != i)
+                vResults[i] = vResults[rep];
+        }
+    }
+
+    // Suelta las páginas de los puntos de control
+    checkpoints.clear();
+
+    bRunning = false;
+    bFinished.store(true, std::memory_order_release);
+}
+
+// Decide qué inyecciones hay que ejecutar. Las descartadas por el análisis
+// de vida ya cuentan como completadas
+void CampaignExecutor::planRuns(){
+    uint32_t nInjections = campaign.injections.size();
+
+    vRepresentative.resize(nInjections);
+    if (settings.bLiveness && !checkpoints.empty()) {
+        // Otra vez desde el principio de la ejecución de referencia
+        Computer &computer = *workers[0]->computer;
+        computer.restore(checkpoints.nearest(0).state);
+        analyzeLiveness(computer, campaign, campaign.expectedInstructions, vRepresentative);
+    } else {
+        for (uint32_t i = 0; i < nInjections; i++)
+            vRepresentative[i] = i;
+    }
+
+    vRuns.clear();
+    vWeights.clear();
+    std::vector<uint32_t> runOf(nInjections);     // Posición en vRuns de cada representante
+    uint32_t nDead = 0;
+
+    for (uint32_t i = 0; i < nInjections; i++) {
+        if (vRepresentative[i] == i) {
+            runOf[i] = vRuns.size();
+            vRuns.push_back(i);
+            vWeights.push_back(0);
+        }
+    }
+
+    for (uint32_t i = 0; i < nInjections; i++) {
+        uint32_t rep = vRepresentative[i];
+        if (rep == DEAD_INJECTION)
+            nDead++;
+        else
+            vWeights[runOf[rep]]++;
+    }
+
+    counters[NO_EFFECT] += nDead;
+    iCompleted += nDead;
+}
+
+void CampaignExecutor::runWorker(size_t id){
+    Worker &self = *workers[id];
+
+    uint32_t run;
+    while (!bCancel.load(std::memory_order_relaxed)) {
+        if (!takeLocal(self, run) && !steal(id, run))
+            break;  // No queda nada en ningún hilo
+
+        uint32_t index = vRuns[run];
+        CampaignResult result = runInjection(self, index);
+
+        vResults[index] = result;
+        counters[result].fetch_add(vWeights[run], std::memory_order_relaxed);
+        iCompleted.fetch_add(vWeights[run], std::memory_order_relaxed);
+    }
+}
+
+//===================================================
+//                  MUESTREO
+//===================================================
+
+// Prepara el orden al azar de la muestra y los resultados por posición
+void CampaignExecutor::prepareSample(){
+    uint32_t nInjections = campaign.injections.size();
+
+    pSampleResults.reset(new std::atomic<uint8_t>[nInjections]);
+    pRunResults.reset(new std::atomic<uint8_t>[nInjections]);
+    for (uint32_t i = 0; i < nInjections; i++) {
+        pSampleResults[i] = SAMPLE_PENDING;
+        pRunResults[i] = SAMPLE_PENDING;
+    }
+
+    // Los contadores son solo los de la muestra, sin las muertas de planRuns()
+    iCompleted = 0;
+    for (auto &counter : counters)
+        counter = 0;
+    iNextSample = 0;
+    iCounted = 0;
+
+    // Permutación de 2 * iSampleHalfBits bits que cubre todas las inyecciones
+    uint32_t bits = 2;
+    while (bits < 32 && (1ull << bits) < nInjections)
+        bits += 2;
+    iSampleHalfBits = bits / 2;
+    iSampleKey = SplitMix64(settings.seed).next();
+    dSampleZ = confidenceZ(settings.confidence);
+}
+
+// Inyección de la posición position de la muestra. Es una red de Feistel de
+// cuatro vueltas sobre los índices: una permutación al azar que no hace
+// falta guardar. Los valores que se salen de la campaña se vuelven a
+// permutar hasta que caen dentro
+uint32_t CampaignExecutor::sampleAt(uint32_t position) const{
+    uint64_t mask = (1ull << iSampleHalfBits) - 1;
+    uint64_t x = position;
+
+    do {
+        uint64_t left = x >> iSampleHalfBits;
+        uint64_t right = x & mask;
+        for (uint64_t round = 0; round < 4; round++) {
+            uint64_t f = SplitMix64(iSampleKey ^ (right << 8) ^ round).next() & mask;
+            uint64_t next = left ^ f;
+            left = right;
+            right = next;
+        }
+        x = (left << iSampleHalfBits) | right;
+    } while (x >= campaign.injections.size());
+
+    return static_cast<uint32_t>(x);
+}
+
+void CampaignExecutor::runSampler(size_t id){
+    Worker &self = *workers[id];
+    uint32_t nInjections = campaign.injections.size();
+
+    while (!bCancel.load(std::memory_order_relaxed) && !bConverged.load(std::memory_order_relaxed)) {
+        uint32_t position = iNextSample.fetch_add(1, std::memory_order_relaxed);
+        if (position >= nInjections)
+            break;
+
+        CampaignResult result = sampleResult(self, sampleAt(position));
+        pSampleResults[position].store(result, std::memory_order_release);
+        countSamples();
+    }
+}
+
+// Resultado de una inyección de la muestra. Las que representan a otras
+// (ver analyzeLiveness()) se ejecutan solo la primera vez que salen
+CampaignResult CampaignExecutor::sampleResult(Worker &worker, uint32_t index){
+    uint32_t rep = vRepresentative[index];
+    if (rep == DEAD_INJECTION)
+        return NO_EFFECT;
+
+    uint8_t known = pRunResults[rep].load(std::memory_order_acquire);
+    if (known != SAMPLE_PENDING)
+        return static_cast<CampaignResult>(known);
+
+    CampaignResult result = runInjection(worker, rep);
+    pRunResults[rep].store(result, std::memory_order_release);
+    return result;
+}
+
+// Cuenta las posiciones seguidas que ya han terminado y para la campaña si
+// todos los márgenes de error están por debajo del pedido
+void CampaignExecutor::countSamples(){
+    std::lock_guard<std::mutex> lock(mSample);
+    uint32_t nInjections = campaign.injections.size();
+
+    uint32_t counted = iCounted;
+    while (counted < nInjections) {
+        uint8_t result = pSampleResults[counted].load(std::memory_order_acquire);
+        if (result == SAMPLE_PENDING)
+            break;
+        counters[result].fetch_add(1, std::memory_order_relaxed);
+        counted++;
+    }
+
+    if (counted == iCounted)
+        return;
+    iCounted = counted;
+    iCompleted.store(counted, std::memory_order_relaxed);
+
+    if (counted < MIN_SAMPLE || counted == nInjections)
+        return;
+
+    for (const auto &counter : counters) {
+        if (wilsonMargin(counter.load(std::memory_order_relaxed), counted, nInjections, dSampleZ) > settings.margin)
+            return;
+    }
+    bConverged.store(true, std::memory_order_release);
+}
+
+// Coge la primera inyección pendiente del tramo propio
+bool CampaignExecutor::takeLocal(Worker &worker, uint32_t &index){
+    uint64_t range = worker.range.load(std::memory_order_acquire);
+
+    while (true) {
+        uint32_t begin = range >> 32;
+        uint32_t end = static_cast<uint32_t>(range);
+        if (begin >= end)
+            return false;
+
+        if (worker.range.compare_exchange_weak(range, packRange(begin + 1, end), std::memory_order_acq_rel)) {
+            index = begin;
+            return true;
+        }
+    }
+}
+
+// Roba la segunda mitad del tramo de otro hilo. Se queda con la primera
+// inyección robada y deja el resto en su propio tramo, que estaba vacío
+bool CampaignExecutor::steal(size_t thief, uint32_t &index){
+    size_t nWorkers = workers.size();
+
+    for (size_t k = 1; k < nWorkers; k++) {
+        Worker &victim = *workers[(thief + k) % nWorkers];
+        uint64_t range = victim.range.load(std::memory_order_acquire);
+
+        while (true) {
+            uint32_t begin = range >> 32;
+            uint32_t end = static_cast<uint32_t>(range);
+            if (begin >= end)
+                break;
+
+            uint32_t middle = begin + (end - begin) / 2;
+            if (victim.range.compare_exchange_weak(range, packRange(begin, middle), std::memory_order_acq_rel)) {
+                index = middle;
+                workers[thief]->range.store(packRange(middle + 1, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Ejecuta una inyección desde el último punto de control anterior a ella
+CampaignResult CampaignExecutor::runInjection(Worker &worker, uint32_t index){
+    Computer &computer = *worker.computer;
+    uint32_t cycle = campaign.injections[index].cycle;
+
+    const Checkpoint &checkpoint = checkpoints.nearest(cycle);
+    computer.restore(checkpoint.state);
+
+    // Si tarda el doble de lo esperado en ejecutarse, se da por colgado.
+    // Los hashes se comprueban a partir de la inyección
+    EventScheduler &events = computer.events;
+    events.clear();
+    events.schedule(cycle, EventType::Injection, index);
+    events.schedule(static_cast<uint32_t>(std::min<uint64_t>(campaign.expectedInstructions * 2ull, StopCondition::NONE)),
+                    EventType::Limit);
+    uint32_t pendingInjections = 1;
+
+    bool bHashes = checkpoints.hasHashes();
+    if (bHashes)
+        worker.hasher.start(computer, *checkpoint.state.ram, checkpoint.memoryHash);
+
+    // Programa la siguiente comprobación, o deja de seguir las páginas si
+    // no quedan hashes con los que comparar
+    auto scheduleHash = [&]() {
+        uint32_t next = checkpoints.nextHashCycle(computer.cpu.cycles);
+        if (next != StopCondition::NONE)
+            events.schedule(next, EventType::HashCheck);
+        else
+            worker.hasher.stop(computer);
+    };
+
+    bool bMasked = false;
+    bool bLimit = false;
+
+    StopReason reason = StopReason::Budget;
+    while (!bMasked && !bLimit) {
+        reason = computer.run(StopCondition::NONE);
+        if (reason != StopReason::Event)
+            break;
+
+        // Todos los eventos de este ciclo
+        while (!bMasked && !bLimit && events.nextCycle() == computer.cpu.cycles) {
+            Event event = events.pop();
+
+            switch (event.type) {
+            case EventType::Injection: {
+                const Injection &injection = campaign.injections[event.data];
+                computer.cpu.registers[injection.reg] ^= (1u << injection.bit);   // invierte el bit utilizando XOR
+
+                if (--pendingInjections == 0 && bHashes)
+                    scheduleHash();
+                break;
+            }
+
+            // Si el estado es el de referencia, el resto de la ejecución
+            // también lo será
+            case EventType::HashCheck:
+                if (worker.hasher.matches(computer, checkpoints.hashAt(event.cycle)))
+                    bMasked = true;
+                else
+                    scheduleHash();
+                break;
+
+            case EventType::Limit:
+                bLimit = true;
+                break;
+            }
+        }
+    }
+
+    events.clear();
+    if (bHashes)
+        worker.hasher.stop(computer);
+
+    if (bMasked)
+        return NO_EFFECT;
+
+    if (reason != StopReason::Finished)
+        return DUE;     // Ha saltado una excepción o ha llegado al límite sin terminar
+
+    if (computer.ram.readByte(settings.resultAddr) != campaign.expectedResult)
+        return SDC;
+
+    if (campaign.expectedInstructions > computer.cpu.cycles)
+        return SED;
+
+    return NO_EFFECT;
+}
+
+double confidenceMargin(uint32_t hits, uint32_t n, uint64_t population, double confidence){
+    return wilsonMargin(hits, n, population, confidenceZ(confidence));
+}
+
+std::string campaignSummary(const std::vector<uint8_t> &results, double confidence, uint64_t population){
+    float noeffect = 0, sdc = 0, sed = 0, due = 0;
+
+    int hundred = results.size();
+
+    for (uint8_t res : results) {
+        switch (res) {
+        case NO_EFFECT:
+            noeffect++;
+            break;
+        case SDC:
+            sdc++;
+            break;
+        case SED:
+            sed++;
+            break;
+        case DUE:
+            due++;
+            break;
+        }
+    }
+
+    const uint32_t counts[4] = { uint32_t(noeffect), uint32_t(sdc), uint32_t(sed), uint32_t(due) };
+
+    // Cálculo de porcentajes
+    if (hundred > 0) {
+        noeffect = (noeffect * 100) / hundred;
+        sdc = (sdc * 100) / hundred;
+        sed = (sed * 100) / hundred;
+        due = (due * 100) / hundred;
+    }
+
+    char str[160];
+    std::snprintf(str, sizeof(str), "Resultados de la campaña:\nNo effect: %.2f%%\nSDC: %.2f%%\nSED: %.2f%%\nDUE: %.2f%%",
+                  noeffect, sdc, sed, due);
+
+    // Con una muestra, cada porcentaje con su margen de error
+    if (confidence > 0 && hundred > 0 && static_cast<uint64_t>(hundred) < population) {
+        double z = confidenceZ(confidence);
+        const float percents[4] = { noeffect, sdc, sed, due };
+        const char *const names[4] = { "No effect", "SDC", "SED", "DUE" };
+
+        std::string summary = "Resultados de la campaña:";
+        for (int i = 0; i < 4; i++) {
+            std::snprintf(str, sizeof(str), "\n%s: %.2f%% ± %.2f%%", names[i], percents[i],
+                          100 * wilsonMargin(counts[i], hundred, population, z));
+            summary += str;
+        }
+        std::snprintf(str, sizeof(str), "\nMuestra: %d de %llu inyecciones (confianza del %g%%)",
+                      hundred, static_cast<unsigned long long>(population), confidence * 100);
+        return summary + str;
+    }
+
+    return str;
+}
@@ -0,0 +1,163 @@
+#ifndef CAMPAIGNEXECUTOR_H
+#define CAMPAIGNEXECUTOR_H
+
+/*
+    Ejecutor de campañas de inyección de errores en paralelo.
+
+    Cada hilo tiene su propio Computer. Las inyecciones se reparten en
+    tramos contiguos, uno por hilo, y cuando un hilo acaba el suyo roba la
+    mitad de lo que le queda a otro (work stealing), porque las ejecuciones
+    no duran lo mismo: un DUE que se cuelga tarda el doble que la ejecución
+    de referencia, y uno que salta a una excepción (ver Trap en cpu.h) para
+    en cuanto llega a ella.
+
+    Todos los hilos empiezan desde los mismos puntos de control de la
+    ejecución de referencia, que se comparten sin copiarlos. Los resultados
+    se cuentan con contadores atómicos, así que la interfaz solo tiene que
+    consultar el progreso de vez en cuando.
+
+    La ejecución de referencia también guarda el hash del estado cada cierto
+    número de instrucciones. Cuando una ejecución con inyección llega a uno
+    de esos ciclos con el mismo hash, el error ya se ha enmascarado y se da
+    por NO_EFFECT sin seguir.
+
+    Antes de repartir, el análisis de vida de los registros descarta las
+    inyecciones en registros que no se vuelven a leer y junta las que dan
+    el mismo resultado. Solo se ejecuta una de cada grupo, y cuenta por
+    todas las del grupo.
+
+    Si no hacen falta todas las inyecciones sino los porcentajes con cierto
+    margen de error, la campaña se puede muestrear: las inyecciones se
+    ejecutan en un orden al azar y se para cuando el intervalo de confianza
+    de los cuatro resultados es lo bastante estrecho. Solo se cuentan las
+    primeras del orden que ya han terminado todas, para que las que tardan
+    más (los DUE) no salgan de menos.
+*/
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "checkpoints.h"
+#include "computer.h"
+#include "statehash.h"
+
+enum CampaignResult{
+    NO_EFFECT,
+    SDC,
+    SED,
+    DUE
+};
+
+// Resumen con el porcentaje de cada resultado, el mismo en la interfaz y
+// en kronos-cli. Si results es una muestra de population inyecciones, con
+// confidence se añade el margen de error de cada porcentaje
+std::string campaignSummary(const std::vector<uint8_t> &results, double confidence = 0, uint64_t population = 0);
+
+// Margen de error (en tanto por uno) de la proporción hits / n con el nivel
+// de confianza confidence (0.95...), según el intervalo de Wilson, cuando la
+// muestra es de una población de population inyecciones
+double confidenceMargin(uint32_t hits, uint32_t n, uint64_t population, double confidence);
+
+struct CampaignSettings {
+    uint32_t resultAddr;                // Dirección del resultado del programa
+    uint32_t checkpointCount = 64;      // Puntos de control de la ejecución de referencia
+    uint32_t hashPointCount = 1024;     // Hashes del estado para dar antes por NO_EFFECT (0 para no usarlos)
+    bool bLiveness = true;              // No ejecutar las inyecciones que decide el análisis de vida (liveness.h)
+    unsigned threads = 0;               // 0 para usar un hilo por núcleo del procesador
+
+    // Muestreo: confianza (0.95...) y margen de error (0.01 para ±1%) de
+    // los porcentajes. Con confidence a 0 se ejecutan todas
+    double confidence = 0;
+    double margin = 0.01;
+    uint64_t seed = 0;                  // Semilla del orden de la muestra
+};
+
+class CampaignExecutor {
+public:
+    CampaignExecutor();
+    ~CampaignExecutor();
+
+    // Empieza a ejecutar la campaña en segundo plano, con ordenadores
+    // configurados igual que model (RAM, ROM, núcleo y dirección de fin).
+    // Devuelve 1 si ya hay una campaña en marcha
+    int start(const Computer &model, const Campaign &campaign, const CampaignSettings &settings);
+
+    // Para la campaña en marcha y espera a que terminen los hilos
+    void cancel();
+
+    bool finished() const { return bFinished.load(std::memory_order_acquire); }
+    uint32_t completed() const { return iCompleted.load(std::memory_order_relaxed); }
+    uint32_t total() const { return campaign.injections.size(); }
+    uint32_t count(CampaignResult result) const { return counters[result].load(std::memory_order_relaxed); }
+
+    // Resultado (CampaignResult) de cada inyección. Solo es válido cuando finished().
+    // Si se muestrea, son los de la muestra en el orden en que se han sacado
+    const std::vector<uint8_t>& results() const { return vResults; }
+
+    bool sampling() const { return settings.confidence > 0; }
+
+    // Si la muestra ha llegado al margen de error pedido antes de acabar
+    bool converged() const { return bConverged.load(std::memory_order_acquire); }
+
+private:
+    struct Worker {
+        std::unique_ptr<Computer> computer;
+        StateHasher hasher;
+
+        // Ejecuciones pendientes [begin, end) de vRuns, con begin en los 32 bits altos.
+        // El dueño las coge por delante y los demás roban por detrás
+        std::atomic<uint64_t> range{0};
+    };
+
+    Campaign campaign;
+    CampaignSettings settings;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    CheckpointSet checkpoints;
+
+    std::thread controller;
+    std::atomic<bool> bRunning{false};
+    std::atomic<bool> bFinished{false};
+    std::atomic<bool> bCancel{false};
+
+    std::atomic<uint32_t> iCompleted{0};
+    std::atomic<uint32_t> counters[4];
+    std::vector<uint8_t> vResults;
+
+    // Inyecciones que hay que ejecutar (los tramos de los hilos son índices
+    // de vRuns) y cuántas de la campaña representa cada una
+    std::vector<uint32_t> vRuns;
+    std::vector<uint32_t> vWeights;
+    std::vector<uint32_t> vRepresentative;  // Ver analyzeLiveness()
+
+    // Muestreo. La posición i de la muestra es la inyección sampleAt(i)
+    std::atomic<uint32_t> iNextSample{0};                   // Siguiente posición sin repartir
+    std::unique_ptr<std::atomic<uint8_t>[]> pSampleResults; // Por posición, SAMPLE_PENDING si no ha terminado
+    std::unique_ptr<std::atomic<uint8_t>[]> pRunResults;    // Por inyección, de las que ya se han ejecutado
+    std::mutex mSample;                                     // Protege iCounted
+    uint32_t iCounted = 0;                                  // Posiciones seguidas ya contadas
+    uint64_t iSampleKey = 0;
+    uint32_t iSampleHalfBits = 0;
+    double dSampleZ = 0;
+    std::atomic<bool> bConverged{false};
+
+    void run();
+    void planRuns();
+    void runWorker(size_t id);
+    void runSampler(size_t id);
+
+    void prepareSample();
+    uint32_t sampleAt(uint32_t position) const;
+    CampaignResult sampleResult(Worker &worker, uint32_t index);
+    void countSamples();
+
+    bool takeLocal(Worker &worker, uint32_t &index);
+    bool steal(size_t thief, uint32_t &index);
+
+    CampaignResult runInjection(Worker &worker, uint32_t index);
+};
+
+#endif // CAMPAIGNEXECUTOR_H
@@ -0,0 +1,251 @@
+#include "campaignfile.h"
+#include "endian.h"
+#include "json.h"
+#include "mappedfile.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char MAGIC[8] = { 'K', 'R', 'N', 'C', 'A', 'M', 'P', '1' };
+static const uint32_t HEADER_FIXED = 32;
+
+static bool validInjection(uint32_t reg, uint32_t bit){
+    return reg < 32 && bit < 32;
+}
+
+bool isBinaryCampaign(const std::string &filename){
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+int readCampaignJson(const std::string &filename, Campaign &campaign){
+    // Leer y analizar el archivo JSON
+    JsonValue json;
+    std::string error;
+    if (readJsonFile(filename, json, &error) != 0) {
+        std::cerr << "Error al leer el archivo JSON: " << error << std::endl;
+        return 1;
+    }
+
+    // Verificar si el documento es un objeto JSON
+    if (json.type != JsonValue::Type::Object) {
+        std::cerr << "El archivo JSON no contiene un objeto JSON" << std::endl;
+        return 1;
+    }
+
+    const JsonValue &injectionsArray = json["injections"];
+
+    std::vector<Injection> injections;
+    injections.reserve(injectionsArray.size());
+    for (size_t i = 0; i < injectionsArray.size(); i++) {
+        const JsonValue &injection = injectionsArray[i];
+        int cycle = injection[0].toInt(-1);
+        int reg = injection[1].toInt(-1);
+        int bit = injection[2].toInt(-1);
+
+        if (cycle < 0 || !validInjection(reg, bit)) {
+            std::cerr << "Inyección " << i << " no válida" << std::endl;
+            return 1;
+        }
+        injections.push_back({ static_cast<uint32_t>(cycle), static_cast<uint8_t>(reg), static_cast<uint8_t>(bit), 0 });
+    }
+
+    campaign.programPath = json["program"].toString();
+    campaign.expectedResult = json["expectedResult"].toInt();
+    campaign.expectedInstructions = static_cast<uint32_t>(json["expectedInstructions"].toInt());
+    campaign.injections = InjectionList(std::move(injections));
+
+    return 0;
+}
+
+static uint32_t readLittle32(const uint8_t *data){
+    uint32_t value;
+    std::memcpy(&value, data, 4);
+    return LittleWord(value);
+}
+
+int readCampaignBinary(const std::string &filename, Campaign &campaign){
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (file->open(filename) != 0) {
+        std::cerr << "Error al abrir el archivo: " << filename << std::endl;
+        return 1;
+    }
+
+    const uint8_t *data = file->data();
+    size_t size = file->size();
+
+    if (size < HEADER_FIXED || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "No es una campaña binaria: " << filename << std::endl;
+        return 1;
+    }
+
+    uint32_t headerSize = readLittle32(data + 8);
+    uint32_t pathLength = readLittle32(data + 20);
+    uint64_t count = readLittle32(data + 24) | static_cast<uint64_t>(readLittle32(data + 28)) << 32;
+
+    // En 64 bits, para que una longitud de la ruta enorme no dé la vuelta
+    if (headerSize % 8 != 0 || headerSize > size || pathLength > size - HEADER_FIXED
+        || headerSize < static_cast<uint64_t>(HEADER_FIXED) + pathLength
+        || count > (size - headerSize) / sizeof(Injection)) {
+        std::cerr << "Campaña binaria no válida: " << filename << std::endl;
+        return 1;
+    }
+
+    const Injection *records = reinterpret_cast<const Injection*>(data + headerSize);
+
+    for (uint64_t i = 0; i < count; i++) {
+        if (!validInjection(records[i].reg, records[i].bit)) {
+            std::cerr << "Inyección " << i << " no válida" << std::endl;
+            return 1;
+        }
+    }
+
+    campaign.programPath.assign(reinterpret_cast<const char*>(data + HEADER_FIXED), pathLength);
+    campaign.expectedResult = static_cast<int32_t>(readLittle32(data + 12));
+    campaign.expectedInstructions = readLittle32(data + 16);
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // En un host big-endian los ciclos hay que darles la vuelta, así que se copian
+    std::vector<Injection> injections(records, records + count);
+    for (Injection &injection : injections)
+        injection.cycle = LittleWord(injection.cycle);
+    campaign.injections = InjectionList(std::move(injections));
+#else
+    // La lista mantiene el archivo mapeado mientras se use
+    campaign.injections = InjectionList(file, records, count);
+#endif
+
+    return 0;
+}
+
+static void putLittle32(std::string &out, uint32_t value){
+    for (int i = 0; i < 4; i++)
+        out += static_cast<char>(value >> (8 * i));
+}
+
+bool isJsonFilename(const std::string &filename){
+    return filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+}
+
+CampaignWriter::~CampaignWriter(){
+    if (file.is_open())
+        close();
+}
+
+int CampaignWriter::open(const std::string &filename, const Campaign &campaign, uint64_t count, bool bJson){
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error al crear el archivo: " << filename << std::endl;
+        return 1;
+    }
+
+    this->filename = filename;
+    this->bJson = bJson;
+    iCount = count;
+    iWritten = 0;
+    buffer.clear();
+
+    if (bJson) {
+        // La ruta se escribe con las comillas y barras escapadas
+        std::string program;
+        for (char c : campaign.programPath) {
+            if (c == '"' || c == '\\')
+                program += '\\';
+            program += c;
+        }
+
+        file << "{\n"
+             << "    \"program\": \"" << program << "\",\n"
+             << "    \"expectedResult\": " << campaign.expectedResult << ",\n"
+             << "    \"expectedInstructions\": " << campaign.expectedInstructions << ",\n"
+             << "    \"injections\": [";
+        return 0;
+    }
+
+    uint32_t pathLength = campaign.programPath.size();
+    uint32_t headerSize = (HEADER_FIXED + pathLength + 7) & ~7u;
+
+    std::string header(MAGIC, sizeof(MAGIC));
+    putLittle32(header, headerSize);
+    putLittle32(header, campaign.expectedResult);
+    putLittle32(header, campaign.expectedInstructions);
+    putLittle32(header, pathLength);
+    putLittle32(header, static_cast<uint32_t>(count));
+    putLittle32(header, static_cast<uint32_t>(count >> 32));
+    header += campaign.programPath;
+    header.resize(headerSize, '\0');
+    file.write(header.data(), header.size());
+
+    return 0;
+}
+
+void CampaignWriter::write(const Injection *injections, size_t n){
+    for (size_t i = 0; i < n; i++) {
+        const Injection &injection = injections[i];
+
+        if (bJson) {
+            // Una inyección por línea
+            buffer += iWritten == 0 ? "\n        [" : ",\n        [";
+            buffer += std::to_string(injection.cycle);
+            buffer += ", ";
+            buffer += std::to_string(injection.reg);
+            buffer += ", ";
+            buffer += std::to_string(injection.bit);
+            buffer += ']';
+        } else {
+            putLittle32(buffer, injection.cycle);
+            buffer += static_cast<char>(injection.reg);
+            buffer += static_cast<char>(injection.bit);
+            buffer += '\0';
+            buffer += '\0';
+        }
+        iWritten++;
+
+        // Por bloques, para no hacer una escritura por inyección
+        if (buffer.size() >= 64 * 1024) {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+}
+
+int CampaignWriter::close(){
+    file.write(buffer.data(), buffer.size());
+    buffer.clear();
+
+    if (bJson)
+        file << "\n    ]\n}\n";
+
+    bool bGood = file.good();
+    file.close();
+
+    if (!bGood) {
+        std::cerr << "Error al escribir el archivo: " << filename << std::endl;
+        return 1;
+    }
+    // En binario la cabecera ya dice cuántas hay
+    if (!bJson && iWritten != iCount) {
+        std::cerr << "Se esperaban " << iCount << " inyecciones y se han escrito " << iWritten << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int writeCampaign(const std::string &filename, const Campaign &campaign, bool bJson){
+    CampaignWriter writer;
+    if (writer.open(filename, campaign, campaign.injections.size(), bJson) != 0)
+        return 1;
+
+    writer.write(campaign.injections.begin(), campaign.injections.size());
+    return writer.close();
+}
+
+int writeCampaignJson(const std::string &filename, const Campaign &campaign){
+    return writeCampaign(filename, campaign, true);
+}
+
+int writeCampaignBinary(const std::string &filename, const Campaign &campaign){
+    return writeCampaign(filename, campaign, false);
+}
@@ -0,0 +1,68 @@
+#ifndef CAMPAIGNFILE_H
+#define CAMPAIGNFILE_H
+
+/*
+    Archivos de campaña. Hay dos formatos:
+
+    - JSON: { "program", "expectedResult", "expectedInstructions",
+      "injections": [[ciclo, registro, bit], ...] }. Se mantiene para
+      importar y exportar.
+
+    - Binario (.kcamp), el que genera la interfaz, para campañas de
+      millones de inyecciones. Se mapea
+      en memoria y las inyecciones se usan directamente desde el archivo.
+      Todo en little-endian:
+
+          0   "KRNCAMP1"
+          8   uint32  tamaño de la cabecera (múltiplo de 8)
+          12  int32   expectedResult
+          16  uint32  expectedInstructions
+          20  uint32  longitud de la ruta del programa
+          24  uint64  número de inyecciones
+          32  ruta del programa, rellenada con ceros hasta la cabecera
+          ... inyecciones, 8 bytes cada una (ver injections.h):
+              uint32 ciclo, uint8 registro, uint8 bit, uint16 a 0
+
+    Todas las funciones devuelven 1 si hay algún error.
+*/
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "computer.h"
+
+// Si el archivo empieza como una campaña binaria
+bool isBinaryCampaign(const std::string &filename);
+
+int readCampaignJson(const std::string &filename, Campaign &campaign);
+int readCampaignBinary(const std::string &filename, Campaign &campaign);
+
+int writeCampaignJson(const std::string &filename, const Campaign &campaign);
+int writeCampaignBinary(const std::string &filename, const Campaign &campaign);
+
+// Si filename acaba en .json. Si no, se escribe en binario
+bool isJsonFilename(const std::string &filename);
+
+// Escribe una campaña poco a poco, sin tener todas las inyecciones en
+// memoria. Hay que saber cuántas van a ser antes de empezar
+class CampaignWriter {
+public:
+    ~CampaignWriter();
+
+    // Crea el archivo y escribe la cabecera de campaign (sin sus inyecciones)
+    int open(const std::string &filename, const Campaign &campaign, uint64_t count, bool bJson);
+
+    void write(const Injection *injections, size_t n);
+
+    // Devuelve 1 si ha fallado alguna escritura o no se han escrito count
+    int close();
+
+private:
+    std::ofstream file;
+    std::string filename;
+    std::string buffer;
+    bool bJson = false;
+    uint64_t iCount = 0;
+    uint64_t iWritten = 0;
+};
+
+#endif // CAMPAIGNFILE_H
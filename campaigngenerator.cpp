@@ -0,0 +1,89 @@
+#include "campaigngenerator.h"
+#include "campaignfile.h"
+#include "goldencache.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static const uint32_t REGISTERS = 31;                   // x1 a x31
+static const uint32_t BLOCK = REGISTERS * 32;           // Todos los pares registro-bit
+static const uint32_t BLOCKS_PER_BATCH = 1024;          // Unas 1M de inyecciones por escritura
+
+// Rellena out con las inyecciones del bloque block
+static void generateBlock(const SplitMix64 &root, uint64_t block, uint64_t count, uint32_t cycles, Injection *out){
+    SplitMix64 random = root.split(block);
+
+    uint64_t first = block * BLOCK;
+    uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(BLOCK, count - first));
+    double scale = static_cast<double>(cycles) / count;
+
+    // Fisher-Yates sobre los pares, hasta donde haga falta
+    uint16_t pairs[BLOCK];
+    for (uint32_t i = 0; i < BLOCK; i++)
+        pairs[i] = i;
+
+    for (uint32_t i = 0; i < n; i++) {
+        std::swap(pairs[i], pairs[i + random.below(BLOCK - i)]);
+
+        uint32_t cycle = static_cast<uint32_t>((first + i + random.unit()) * scale);
+        out[i].cycle = std::min(cycle, cycles - 1);
+        out[i].reg = 1 + pairs[i] / 32;
+        out[i].bit = pairs[i] % 32;
+        out[i].reserved = 0;
+    }
+}
+
+int generateCampaign(const Computer &model, const std::string &program,
+                     const GeneratorSettings &settings, const std::string &filename){
+    GoldenRun golden;
+    if (findGolden(model, program, settings.resultAddr, settings.limit, settings.cacheDir, golden) != 0)
+        return 1;
+    if (golden.instructions == 0) {
+        std::cerr << "El programa termina sin ejecutar ninguna instrucción" << std::endl;
+        return 1;
+    }
+
+    Campaign campaign;
+    campaign.programPath = program;
+    campaign.expectedInstructions = golden.instructions;
+    campaign.expectedResult = golden.result;
+
+    CampaignWriter writer;
+    if (writer.open(filename, campaign, settings.count, isJsonFilename(filename)) != 0)
+        return 1;
+
+    unsigned nThreads = settings.threads;
+    if (nThreads == 0)
+        nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0)
+        nThreads = 1;
+
+    SplitMix64 root(settings.seed);
+    uint64_t nBlocks = (settings.count + BLOCK - 1) / BLOCK;
+    std::vector<Injection> batch;
+
+    for (uint64_t firstBlock = 0; firstBlock < nBlocks; firstBlock += BLOCKS_PER_BATCH) {
+        uint64_t batchBlocks = std::min<uint64_t>(BLOCKS_PER_BATCH, nBlocks - firstBlock);
+        uint64_t batchSize = std::min<uint64_t>(batchBlocks * BLOCK, settings.count - firstBlock * BLOCK);
+        batch.resize(batchSize);
+
+        // Cada hilo se queda con bloques alternos de la tanda
+        auto work = [&](unsigned thread) {
+            for (uint64_t b = thread; b < batchBlocks; b += nThreads)
+                generateBlock(root, firstBlock + b, settings.count, campaign.expectedInstructions, &batch[b * BLOCK]);
+        };
+
+        std::vector<std::thread> threads;
+        unsigned nUsed = static_cast<unsigned>(std::min<uint64_t>(nThreads, batchBlocks));
+        for (unsigned t = 1; t < nUsed; t++)
+            threads.emplace_back(work, t);
+        work(0);
+        for (std::thread &thread : threads)
+            thread.join();
+
+        writer.write(batch.data(), batch.size());
+    }
+
+    return writer.close();
+}
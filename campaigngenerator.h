@@ -0,0 +1,76 @@
+#ifndef CAMPAIGNGENERATOR_H
+#define CAMPAIGNGENERATOR_H
+
+/*
+    Generador de campañas aleatorias.
+
+    Primero hace la ejecución de referencia del programa para saber cuántas
+    instrucciones dura, y después reparte las inyecciones por estratos:
+
+    - Ciclo: la inyección i de n cae en un punto al azar del tramo
+      [i, i + 1) * instrucciones / n, así que todo el programa queda cubierto
+      por igual en vez de solo el principio.
+    - Registro y bit: cada bloque de 992 inyecciones seguidas es una
+      permutación al azar de los 31 registros (x0 no se puede modificar) por
+      los 32 bits, así que cada par sale lo mismo que los demás.
+
+    Cada bloque tiene su propio generador SplitMix64 derivado de la semilla
+    y del número de bloque, así que los bloques se generan en paralelo y la
+    campaña es la misma con cualquier número de hilos. Las inyecciones se
+    escriben al archivo por tandas (ver CampaignWriter), sin tenerlas todas
+    en memoria.
+*/
+#include <cstdint>
+#include <string>
+#include "computer.h"
+
+// Generador pseudoaleatorio SplitMix64. split() da generadores
+// independientes para cada bloque a partir de uno solo
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t next(){
+        state += GAMMA;
+        return mix(state);
+    }
+
+    // Entero uniforme en [0, n)
+    uint32_t below(uint32_t n){ return static_cast<uint32_t>(((next() >> 32) * n) >> 32); }
+
+    // Real uniforme en [0, 1)
+    double unit(){ return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Generador del flujo stream. No avanza este
+    SplitMix64 split(uint64_t stream) const { return SplitMix64(mix(state ^ mix(stream + GAMMA))); }
+
+private:
+    static const uint64_t GAMMA = 0x9E3779B97F4A7C15ull;
+
+    static uint64_t mix(uint64_t z){
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t state;
+};
+
+struct GeneratorSettings {
+    uint64_t count = 1000;              // Inyecciones
+    uint64_t seed = 0;
+    uint32_t resultAddr;                // Dirección del resultado del programa
+    uint32_t limit = 0xFFFFFFFF;        // Límite de instrucciones de la ejecución de referencia
+    unsigned threads = 0;               // 0 para usar un hilo por núcleo del procesador
+    std::string cacheDir;               // Caché de la ejecución de referencia (ver goldencache.h)
+};
+
+// Genera una campaña para program y la escribe en filename, en JSON si
+// acaba en .json y si no en binario. La ejecución de referencia se hace en
+// un ordenador aparte configurado como model (ver findGolden()), y su
+// duración y resultado se guardan en la campaña. Devuelve 1 si hay algún error o si el programa no
+// termina antes del límite
+int generateCampaign(const Computer &model, const std::string &program,
+                     const GeneratorSettings &settings, const std::string &filename);
+
+#endif // CAMPAIGNGENERATOR_H
@@ -0,0 +1,76 @@
+#include "checkpoints.h"
+#include <algorithm>
+
+void CheckpointSet::record(Computer &computer, uint32_t interval, uint32_t limit, uint32_t hashInterval){
+    clear();
+
+    Checkpoint first;
+    first.state = computer.snapshot();
+    checkpoints.push_back(first);
+
+    if (interval == 0 && hashInterval == 0)
+        return;
+
+    StateHasher hasher;
+    if (hashInterval > 0) {
+        iHashInterval = hashInterval;
+        checkpoints[0].memoryHash = computer.ram.contentHash();
+        hasher.start(computer, *checkpoints[0].state.ram, checkpoints[0].memoryHash);
+    }
+
+    uint32_t start = computer.cpu.cycles;
+    uint32_t nextCheckpoint = interval > 0 ? start + interval : StopCondition::NONE;
+    uint32_t nextHash = hashInterval > 0 ? hashInterval : StopCondition::NONE;
+
+    while (computer.cpu.cycles < limit) {
+        uint32_t target = std::min(limit, std::min(nextCheckpoint, nextHash));
+        StopReason reason = computer.run(target - computer.cpu.cycles);
+
+        // Solo se sigue si se ha agotado la ráfaga sin terminar
+        if (reason != StopReason::Budget || computer.cpu.cycles >= limit)
+            break;
+
+        if (computer.cpu.cycles == nextHash) {
+            hashes.push_back(hasher.hash(computer));
+            nextHash += hashInterval;
+        }
+
+        if (computer.cpu.cycles == nextCheckpoint) {
+            Checkpoint checkpoint;
+            if (hashInterval > 0)
+                checkpoint.memoryHash = hasher.memoryHash(computer);
+            checkpoint.state = computer.snapshot();
+            checkpoints.push_back(checkpoint);
+            nextCheckpoint += interval;
+        }
+    }
+
+    if (hashInterval > 0)
+        hasher.stop(computer);
+}
+
+const Checkpoint& CheckpointSet::nearest(uint32_t cycle) const{
+    // Primero con más ciclos que cycle; el bueno es el anterior
+    auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), cycle,
+                               [](uint32_t c, const Checkpoint &checkpoint) { return c < checkpoint.state.cycles; });
+
+    if (it != checkpoints.begin())
+        --it;
+    return *it;
+}
+
+uint32_t CheckpointSet::nextHashCycle(uint32_t cycle) const{
+    if (iHashInterval == 0)
+        return StopCondition::NONE;
+
+    uint64_t index = cycle / iHashInterval;     // El siguiente es el index + 1, que está en hashes[index]
+    if (index >= hashes.size())
+        return StopCondition::NONE;
+    return (index + 1) * iHashInterval;
+}
+
+void CheckpointSet::clear(){
+    checkpoints.clear();
+    hashes.clear();
+    iHashInterval = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef CHECKPOINTS_H
+#define CHECKPOINTS_H
+
+/*
+    Puntos de control de la ejecución de referencia (golden run) de una
+    campaña. Se guarda una instantánea del ordenador cada cierto número de
+    instrucciones, y cada inyección empieza desde la última anterior a su
+    ciclo en vez de desde el principio del programa.
+
+    También se puede guardar el hash del estado (ver statehash.h) cada
+    cierto número de instrucciones, para que las ejecuciones con inyección
+    comprueben si han vuelto al mismo estado que la de referencia.
+*/
+#include <cstdint>
+#include <vector>
+#include "computer.h"
+#include "statehash.h"
+
+struct Checkpoint {
+    ComputerSnapshot state;
+    uint64_t memoryHash = 0;    // Solo si se guardan los hashes
+};
+
+class CheckpointSet {
+public:
+    // Ejecuta el programa desde el estado actual de computer hasta que
+    // termina o llega a limit instrucciones, guardando una instantánea al
+    // empezar y después de cada interval instrucciones, y el hash del
+    // estado cada hashInterval (0 para ninguno)
+    void record(Computer &computer, uint32_t interval, uint32_t limit, uint32_t hashInterval = 0);
+
+    // Punto de control más avanzado que no pasa de cycle. Como el primero es
+    // el del principio, siempre hay uno si no está vacío
+    const Checkpoint& nearest(uint32_t cycle) const;
+
+    // Primer ciclo con hash después de cycle, o StopCondition::NONE
+    uint32_t nextHashCycle(uint32_t cycle) const;
+
+    // Hash del estado de referencia en un ciclo de nextHashCycle()
+    const StateHash& hashAt(uint32_t cycle) const { return hashes[cycle / iHashInterval - 1]; }
+
+    bool hasHashes() const { return !hashes.empty(); }
+    bool empty() const { return checkpoints.empty(); }
+    size_t size() const { return checkpoints.size(); }
+
+    // Suelta todas las instantáneas, y con ellas sus páginas
+    void clear();
+
+private:
+    std::vector<Checkpoint> checkpoints;    // Ordenados por ciclo
+    std::vector<StateHash> hashes;          // El i es el del ciclo (i + 1) * iHashInterval
+    uint32_t iHashInterval = 0;
+};
+
+#endif // CHECKPOINTS_H
@@ -0,0 +1,523 @@
+/*
+    kronos-cli: ejecuta programas y campañas sin interfaz gráfica.
+
+    Usa el mismo config.json que la interfaz y el mismo núcleo (CPU, Memory,
+    CampaignExecutor), pero sin Qt, para poder lanzarlo en servidores.
+
+    Uso:
+        kronos-cli [opciones] programa.bin
+        kronos-cli [opciones] --campaign campaña.json
+        kronos-cli [opciones] --campaign campaña.json --shards N --workdir dir
+        kronos-cli --merge N --workdir dir
+        kronos-cli --convert entrada salida
+        kronos-cli [opciones] --generate programa.bin salida [--count N] [--seed S]
+
+    Opciones:
+        -c, --config archivo    Configuración (por defecto ./config.json)
+        --core nombre           classic, threaded, block o jit
+        --max N                 Límite de instrucciones del programa
+        --stats                 Muestra las instrucciones ejecutadas por operación
+        --threads N             Hilos de la campaña (0 para uno por núcleo)
+        --checkpoints N         Puntos de control de la campaña
+        --hash-points N         Hashes del estado de la campaña (0 para no cortar las inyecciones)
+        --no-liveness           Ejecuta todas las inyecciones, sin el análisis de vida de los registros
+        --confidence C          Muestrea la campaña hasta tener los porcentajes con confianza C (0.95...)
+        --margin M              Margen de error de la muestra (0.01 para ±1%)
+        --shard K/N             Ejecuta solo el trozo K de N de la campaña
+        --shards N              Ejecuta los trozos de N que no haya cogido otro proceso
+        --workdir dir           Directorio compartido con los resultados de los trozos
+        --merge N               Junta los N trozos de workdir y muestra el resumen
+        --convert ent sal       Convierte una campaña entre JSON y binario (.kcamp).
+                                El formato de salida se elige por la extensión
+        --generate prog sal     Genera una campaña aleatoria para prog (ver campaigngenerator.h)
+        --count N               Inyecciones de la campaña generada (por defecto 1000)
+        --seed S                Semilla del generador o del orden de la muestra
+
+    Para repartir una campaña entre varias máquinas, se lanza el mismo
+    comando con --shards en todas, con un directorio de trabajo compartido.
+    Cada proceso ejecuta los trozos que quedan libres (ver shards.h).
+
+    --campaign acepta campañas en JSON o en binario (ver campaignfile.h). Las
+    binarias se cargan al momento aunque tengan millones de inyecciones.
+*/
+#include "campaignexecutor.h"
+#include "campaignfile.h"
+#include "campaigngenerator.h"
+#include "computer.h"
+#include "config.h"
+#include "goldencache.h"
+#include "shards.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+static const uint32_t BURST = 1000000;     // Instrucciones por ráfaga de run()
+
+struct Options {
+    std::string configFile = "./config.json";
+    std::string core;
+    std::string program;
+    std::string campaign;
+    uint64_t maxInstructions = 0;       // 0 sin límite
+    bool bStats = false;
+    int threads = -1;                   // -1 para usar el de la configuración
+    int checkpoints = -1;
+    int hashPoints = -1;
+    bool bNoLiveness = false;
+    double confidence = -1;             // -1 para usar el de la configuración
+    double margin = -1;
+
+    // Reparto en trozos
+    std::string workDir = ".";
+    int shard = -1;                     // -1 para todos (--shards) o la campaña entera
+    uint32_t shardCount = 0;            // 0 sin trozos
+    uint32_t mergeCount = 0;            // --merge
+
+    // --convert
+    std::string convertFrom;
+    std::string convertTo;
+
+    // --generate
+    std::string generateProgram;
+    std::string generateTo;
+    uint64_t generateCount = 1000;
+    bool bSeed = false;
+    uint64_t seed = 0;
+};
+
+static void usage(){
+    std::cerr << "Uso: kronos-cli [-c config.json] [--core classic|threaded|block|jit] [--max N] [--stats]" << std::endl
+              << "                 [--threads N] [--checkpoints N] [--hash-points N] [--no-liveness]" << std::endl
+              << "                 [--confidence C] [--margin M] [--seed S] (programa.bin | --campaign campaña.json)" << std::endl
+              << "                 [--shard K/N | --shards N] [--workdir dir]" << std::endl
+              << "       kronos-cli --merge N [--workdir dir]" << std::endl
+              << "       kronos-cli --convert entrada salida" << std::endl
+              << "       kronos-cli [-c config.json] [--core nombre] [--threads N] --generate programa.bin salida [--count N] [--seed S]" << std::endl;
+}
+
+// Número de trozos de --shards y --merge: un entero mayor que 0, sin nada detrás
+static bool parseShardCount(const char *text, uint32_t &count){
+    unsigned value;
+    char extra;
+    if (text[0] == '-' || std::sscanf(text, "%u%c", &value, &extra) != 1 || value == 0)
+        return false;
+
+    count = value;
+    return true;
+}
+
+static int parseOptions(int argc, char *argv[], Options &options){
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool bHasValue = i + 1 < argc;
+
+        if ((arg == "-c" || arg == "--config") && bHasValue)
+            options.configFile = argv[++i];
+        else if (arg == "--core" && bHasValue)
+            options.core = argv[++i];
+        else if (arg == "--max" && bHasValue)
+            options.maxInstructions = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--stats")
+            options.bStats = true;
+        else if (arg == "--threads" && bHasValue)
+            options.threads = std::atoi(argv[++i]);
+        else if (arg == "--checkpoints" && bHasValue)
+            options.checkpoints = std::atoi(argv[++i]);
+        else if (arg == "--hash-points" && bHasValue)
+            options.hashPoints = std::atoi(argv[++i]);
+        else if (arg == "--no-liveness")
+            options.bNoLiveness = true;
+        else if (arg == "--confidence" && bHasValue)
+            options.confidence = std::atof(argv[++i]);
+        else if (arg == "--margin" && bHasValue)
+            options.margin = std::atof(argv[++i]);
+        else if (arg == "--campaign" && bHasValue)
+            options.campaign = argv[++i];
+        else if (arg == "--workdir" && bHasValue)
+            options.workDir = argv[++i];
+        else if (arg == "--shard" && bHasValue) {
+            unsigned shard, count;
+            if (std::sscanf(argv[++i], "%u/%u", &shard, &count) != 2 || count == 0 || shard >= count) {
+                std::cerr << "Trozo no válido: " << argv[i] << std::endl;
+                return 1;
+            }
+            options.shard = shard;
+            options.shardCount = count;
+        }
+        else if ((arg == "--shards" || arg == "--merge") && bHasValue) {
+            if (!parseShardCount(argv[++i], arg == "--shards" ? options.shardCount : options.mergeCount)) {
+                std::cerr << "Número de trozos no válido: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--convert" && i + 2 < argc) {
+            options.convertFrom = argv[++i];
+            options.convertTo = argv[++i];
+        }
+        else if (arg == "--generate" && i + 2 < argc) {
+            options.generateProgram = argv[++i];
+            options.generateTo = argv[++i];
+        }
+        else if (arg == "--count" && bHasValue)
+            options.generateCount = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && bHasValue) {
+            options.seed = std::strtoull(argv[++i], nullptr, 0);
+            options.bSeed = true;
+        }
+        else if (arg == "-h" || arg == "--help")
+            return 1;
+        else if (arg[0] != '-' && options.program.empty())
+            options.program = arg;
+        else {
+            std::cerr << "Opción no válida: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // Para juntar trozos o convertir una campaña no hace falta nada más
+    if (!options.convertFrom.empty())
+        return options.program.empty() && options.campaign.empty() && options.mergeCount == 0 ? 0 : 1;
+    if (options.mergeCount > 0)
+        return options.program.empty() && options.campaign.empty() ? 0 : 1;
+    if (!options.generateProgram.empty())
+        return options.program.empty() && options.campaign.empty() && options.generateCount > 0 ? 0 : 1;
+
+    // Hace falta un programa o una campaña, pero no los dos
+    if (options.program.empty() == options.campaign.empty())
+        return 1;
+
+    // Los trozos son solo para campañas, y se ejecutan enteros
+    if (options.shardCount > 0 && (options.campaign.empty() || options.confidence > 0))
+        return 1;
+
+    return 0;
+}
+
+// Ejecuta el programa cargado hasta que termina, hace un EBREAK, salta una
+// excepción o llega a maxInstructions. Devuelve el motivo de la parada
+static StopReason runProgram(Computer &computer, uint64_t maxInstructions){
+    uint64_t executed = 0;
+
+    while (true) {
+        uint32_t budget = BURST;
+        if (maxInstructions > 0 && maxInstructions - executed < budget)
+            budget = maxInstructions - executed;
+
+        uint32_t before = computer.cpu.cycles;
+        StopReason reason = computer.run(budget);
+        executed += computer.cpu.cycles - before;
+
+        if (reason != StopReason::Budget)
+            return reason;
+        if (maxInstructions > 0 && executed >= maxInstructions)
+            return reason;
+    }
+}
+
+static void printStats(const Computer &computer){
+    static const char *const tipos[] = { "R", "I", "S", "B", "U", "J" };
+
+    std::cout << std::endl << "Instrucciones por tipo:" << std::endl;
+    for (int i = 0; i < 6; i++)
+        std::cout << "  Tipo " << tipos[i] << ": " << computer.cpu.ciclosTipo[i] << std::endl;
+
+    std::cout << std::endl << "Instrucciones por operación:" << std::endl;
+    for (int op = 0; op < Operation::NOP; op++) {
+        if (computer.cpu.ciclosTotales[op] > 0)
+            std::cout << "  " << std::left << std::setw(8) << mnemonics[op] << std::right
+                      << computer.cpu.ciclosTotales[op] << std::endl;
+    }
+}
+
+static int executeProgram(Computer &computer, const EmulatorConfig &config, const Options &options){
+    computer.reset();
+    if (computer.LoadProgram(options.program) != 0)
+        return 1;
+
+    computer.cpu.stats = options.bStats ? StatsLevel::PerOpcode : StatsLevel::None;
+
+    auto start = std::chrono::steady_clock::now();
+    StopReason reason = runProgram(computer, options.maxInstructions);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    switch (reason) {
+    case StopReason::Finished: std::cout << "Programa finalizado" << std::endl; break;
+    case StopReason::Ebreak:   std::cout << "Parada por EBREAK" << std::endl; break;
+    case StopReason::Trap:
+        std::cout << "Excepción: " << trapName(computer.cpu.trap) << std::hex << std::setfill('0')
+                  << " (PC 0x" << std::setw(8) << computer.cpu.trapPc
+                  << ", dirección 0x" << std::setw(8) << computer.cpu.trapAddr << ")"
+                  << std::dec << std::setfill(' ') << std::endl;
+        break;
+    default:                   std::cout << "Límite de instrucciones alcanzado" << std::endl; break;
+    }
+
+    std::cout << "Instrucciones: " << computer.cpu.cycles << std::endl;
+    std::cout << "Resultado: " << static_cast<int>(computer.ram.readByte(config.resultRamLocation)) << std::endl;
+    std::cout << "Tiempo: " << std::fixed << std::setprecision(3) << seconds << " s";
+    if (seconds > 0)
+        std::cout << " (" << std::setprecision(1) << computer.cpu.cycles / seconds / 1e6 << " M instr/s)";
+    std::cout << std::endl << std::endl;
+
+    std::cout << computer.showRegisters() << std::endl;
+
+    if (options.bStats)
+        printStats(computer);
+
+    return (reason == StopReason::Budget || reason == StopReason::Trap) ? 1 : 0;
+}
+
+// Hace la ejecución de referencia de la campaña cargada si no la trae, o la
+// saca de la caché (ver goldencache.h)
+static int prepareCampaign(Computer &computer, const EmulatorConfig &config, const Options &options){
+    Campaign &campaign = computer.campaign;
+
+    if (campaign.expectedInstructions == 0) {
+        uint32_t limit = StopCondition::NONE;
+        if (options.maxInstructions > 0)
+            limit = static_cast<uint32_t>(std::min<uint64_t>(options.maxInstructions, limit));
+
+        GoldenRun golden;
+        if (findGolden(computer, campaign.programPath, config.resultRamLocation, limit, config.goldenCacheRoute, golden) != 0)
+            return 1;
+
+        campaign.expectedInstructions = golden.instructions;
+        campaign.expectedResult = golden.result;
+    }
+
+    std::cout << "Programa: " << campaign.programPath << std::endl;
+    std::cout << "Instrucciones esperadas: " << campaign.expectedInstructions << std::endl;
+    std::cout << "Resultado esperado: " << campaign.expectedResult << std::endl;
+    std::cout << "Inyecciones: " << campaign.injections.size() << std::endl;
+
+    return 0;
+}
+
+// Ejecuta las inyecciones [begin, end) de la campaña cargada en computer, o
+// una muestra de ellas si confidence no es 0 (ver CampaignSettings).
+// Devuelve 1 si no se han podido ejecutar todas o no se ha llegado al margen
+static int runInjections(Computer &computer, const EmulatorConfig &config, const Options &options,
+                         uint32_t begin, uint32_t end, double confidence, std::vector<uint8_t> &results){
+    Campaign part = computer.campaign;
+    part.injections = computer.campaign.injections.slice(begin, end);
+
+    CampaignSettings settings;
+    settings.resultAddr = config.resultRamLocation;
+    settings.checkpointCount = options.checkpoints >= 0 ? options.checkpoints : config.campaignCheckpoints;
+    settings.hashPointCount = options.hashPoints >= 0 ? options.hashPoints : config.campaignHashPoints;
+    settings.bLiveness = config.campaignLiveness && !options.bNoLiveness;
+    settings.threads = options.threads >= 0 ? options.threads : config.campaignThreads;
+    settings.confidence = confidence;
+    settings.margin = options.margin >= 0 ? options.margin : config.campaignMargin;
+    settings.seed = options.seed;
+
+    std::unique_ptr<CampaignExecutor> executor(new CampaignExecutor);
+    executor->start(computer, part, settings);
+
+    // El progreso va a la salida de error para no mezclarlo con los resultados
+    while (!executor->finished()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::cerr << "\r" << executor->completed() << "/" << executor->total() << std::flush;
+    }
+    std::cerr << std::endl;
+
+    results = executor->results();
+    return executor->completed() == executor->total() || executor->converged() ? 0 : 1;
+}
+
+static int executeCampaign(Computer &computer, const EmulatorConfig &config, const Options &options){
+    if (computer.LoadCampaign(options.campaign) != 0 || prepareCampaign(computer, config, options) != 0)
+        return 1;
+
+    auto start = std::chrono::steady_clock::now();
+
+    double confidence = options.confidence >= 0 ? options.confidence : config.campaignConfidence;
+    uint32_t total = computer.campaign.injections.size();
+
+    std::vector<uint8_t> results;
+    int error = runInjections(computer, config, options, 0, total, confidence, results);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::endl << campaignSummary(results, confidence, total) << std::endl;
+    std::cout << "Tiempo: " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+
+    return error;
+}
+
+// Ejecuta un trozo y deja sus resultados en el directorio de trabajo
+static int executeShard(Computer &computer, const EmulatorConfig &config, const Options &options,
+                        uint32_t shard, uint64_t id){
+    ShardResult result;
+    result.shard = shard;
+    result.shardCount = options.shardCount;
+    result.total = computer.campaign.injections.size();
+    result.campaignId = id;
+
+    ShardRange range = shardRange(result.total, shard, options.shardCount);
+    result.begin = range.begin;
+    result.end = range.end;
+
+    std::cout << "Trozo " << shard << "/" << options.shardCount
+              << ": inyecciones " << range.begin << " a " << range.end << std::endl;
+
+    if (runInjections(computer, config, options, range.begin, range.end, 0, result.results) != 0)
+        return 1;
+
+    return writeShardResult(shardResultFile(options.workDir, shard, options.shardCount), result);
+}
+
+// Junta los trozos del directorio de trabajo y muestra el resumen de la campaña
+static int mergeCampaign(const std::string &workDir, uint32_t shardCount){
+    std::vector<uint8_t> results;
+    std::vector<uint32_t> missing;
+
+    if (mergeShards(workDir, shardCount, results, &missing) != 0) {
+        if (!missing.empty()) {
+            std::cerr << "Faltan " << missing.size() << " de " << shardCount << " trozos:";
+            for (uint32_t shard : missing)
+                std::cerr << " " << shard;
+            std::cerr << std::endl;
+        }
+        return 1;
+    }
+
+    std::cout << "Inyecciones: " << results.size() << std::endl << std::endl;
+    std::cout << campaignSummary(results) << std::endl;
+    return 0;
+}
+
+static int executeShards(Computer &computer, const EmulatorConfig &config, const Options &options){
+    if (computer.LoadCampaign(options.campaign) != 0)
+        return 1;
+
+    // La huella es la de la campaña tal y como está en el archivo, antes de
+    // la ejecución de referencia
+    uint64_t id = campaignId(computer.campaign);
+    bool bPrepared = false;
+
+    for (uint32_t shard = 0; shard < options.shardCount; shard++) {
+        if (options.shard >= 0 && shard != static_cast<uint32_t>(options.shard))
+            continue;
+
+        // Un trozo pedido con --shard se repite aunque ya lo tuviera otro
+        if (options.shard < 0 && !claimShard(options.workDir, shard, options.shardCount))
+            continue;
+
+        // La ejecución de referencia solo hace falta si hay algo que ejecutar
+        if (!bPrepared) {
+            if (prepareCampaign(computer, config, options) != 0)
+                return 1;
+            bPrepared = true;
+        }
+
+        if (executeShard(computer, config, options, shard, id) != 0) {
+            std::cerr << "Ha fallado el trozo " << shard << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.shard >= 0)
+        return 0;
+
+    // Solo el proceso que termina el último tiene todos los trozos
+    std::vector<uint8_t> results;
+    if (mergeShards(options.workDir, options.shardCount, results) != 0) {
+        std::cout << "Quedan trozos en otros procesos. Para el resumen: kronos-cli --merge "
+                  << options.shardCount << " --workdir " << options.workDir << std::endl;
+        return 0;
+    }
+
+    std::cout << std::endl << campaignSummary(results) << std::endl;
+    return 0;
+}
+
+// Convierte una campaña de un formato a otro. Si la salida acaba en .json se
+// escribe en JSON, y si no en binario
+static int convertCampaign(const std::string &from, const std::string &to){
+    Campaign campaign;
+    int error = isBinaryCampaign(from) ? readCampaignBinary(from, campaign)
+                                       : readCampaignJson(from, campaign);
+    if (error)
+        return 1;
+
+    if ((isJsonFilename(to) ? writeCampaignJson(to, campaign) : writeCampaignBinary(to, campaign)) != 0)
+        return 1;
+
+    std::cout << campaign.injections.size() << " inyecciones escritas en " << to << std::endl;
+    return 0;
+}
+
+static int generate(const Computer &computer, const EmulatorConfig &config, const Options &options){
+    GeneratorSettings settings;
+    settings.count = options.generateCount;
+    settings.resultAddr = config.resultRamLocation;
+    settings.threads = options.threads >= 0 ? options.threads : config.campaignThreads;
+    if (options.maxInstructions > 0)
+        settings.limit = static_cast<uint32_t>(std::min<uint64_t>(options.maxInstructions, settings.limit));
+
+    // Sin semilla se coge una al azar, y se muestra para poder repetirla
+    settings.cacheDir = config.goldenCacheRoute;
+    settings.seed = options.bSeed ? options.seed : (static_cast<uint64_t>(std::random_device()()) << 32) | std::random_device()();
+
+    auto start = std::chrono::steady_clock::now();
+    if (generateCampaign(computer, options.generateProgram, settings, options.generateTo) != 0)
+        return 1;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << settings.count << " inyecciones escritas en " << options.generateTo << std::endl;
+    std::cout << "Semilla: " << settings.seed << std::endl;
+    std::cout << "Tiempo: " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    Options options;
+    if (parseOptions(argc, argv, options) != 0) {
+        usage();
+        return 2;
+    }
+
+    if (!options.convertFrom.empty())
+        return convertCampaign(options.convertFrom, options.convertTo);
+
+    if (options.mergeCount > 0)
+        return mergeCampaign(options.workDir, options.mergeCount);
+
+    EmulatorConfig config;
+    if (readConfig(options.configFile, config) != 0)
+        std::cerr << "Se usa la configuración por defecto" << std::endl;
+
+    if (!options.core.empty()) {
+        CPU::Core core;
+        if (!parseCore(options.core, core)) {
+            std::cerr << "Núcleo desconocido: " << options.core << std::endl;
+            return 2;
+        }
+        config.interpreterCore = options.core;
+    }
+
+    // Sin desensamblado no hace falta el historial, y así se puede usar
+    // cualquier núcleo (ver applyConfig)
+    config.disassemblyHistory = 0;
+
+    std::unique_ptr<Computer> computer(new Computer(config.ramSize));
+    applyConfig(config, *computer);
+
+    if (!options.generateProgram.empty())
+        return generate(*computer, config, options);
+
+    if (options.shardCount > 0)
+        return executeShards(*computer, config, options);
+
+    if (!options.campaign.empty())
+        return executeCampaign(*computer, config, options);
+
+    return executeProgram(*computer, config, options);
+}
@@ -2,22 +2,14 @@
 #include <sstream>
 #include <iostream>
 #include <iomanip>
-#include <QFile>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
+#include "campaignfile.h"
 #include <fstream>
-#include <iostream>
-#include <thread>
-#include <mutex>
 #include <vector>
 
 // Constructor
-Computer::Computer(int RAM_SIZE) : ram(Memory(RAM_SIZE)), cpu(CPU(&ram)), ram_size(RAM_SIZE) {};
-Computer::Computer(int RAM_SIZE, QTextEdit *termb)
-    : ram(Memory(RAM_SIZE)), cpu(CPU(&ram)), ram_size(RAM_SIZE)
-    , terminalBox(termb)
-{};
+Computer::Computer(uint32_t RAM_SIZE) : ram(Memory(RAM_SIZE)), cpu(CPU(&ram)), ram_size(RAM_SIZE) {
+    ram.pICache = &cpu.icache;  // Las escrituras en memoria invalidan la caché de instrucciones
+};
 
 Computer::~Computer() {}
 
@@ -25,6 +17,40 @@ Computer::~Computer() {}
 void Computer::reset(){
     cpu.reset();
     ram.reset();
+    events.clear();
+}
+
+ComputerSnapshot Computer::snapshot(){
+    ComputerSnapshot snap;
+
+    for (int i = 0; i < 32; i++)
+        snap.registers[i] = cpu.registers[i];
+    snap.pc = cpu.pc;
+    snap.ir = cpu.ir;
+    snap.cycles = cpu.cycles;
+    snap.ram = ram.snapshot();
+
+    return snap;
+}
+
+void Computer::restore(const ComputerSnapshot &snap){
+    cpu.reset();
+
+    for (int i = 0; i < 32; i++)
+        cpu.registers[i] = snap.registers[i];
+    cpu.pc = snap.pc;
+    cpu.ir = snap.ir;
+    cpu.cycles = snap.cycles;
+
+    ram.restore(*snap.ram);
+}
+
+// Ejecuta hasta budget instrucciones seguidas. Para antes si termina el
+// programa, se cumple alguna de las condiciones de stop o llega el ciclo del
+// siguiente evento
+StopReason Computer::run(uint32_t budget){
+    stop.eventCycle = events.nextCycle();
+    return cpu.run(budget, stop);
 }
 
 // Esta función carga el programa en memoria. En concreto
@@ -49,68 +75,25 @@ int Computer::LoadProgram(std::string filename) {
     }
 
     file.close();
+
+    // La caché de instrucciones cubre todo el programa cargado
+    cpu.icache.setRegion(ram.iRomStartAddr, i - ram.iRomStartAddr);
+
     return 0;
 }
 
-// Esta función carga una campaña de inyección de errores
+// Esta función carga una campaña de inyección de errores, en JSON o en el
+// formato binario (ver campaignfile.h)
 int Computer::LoadCampaign(std::string filename) {
-
-    // Abrir el archivo JSON
-    QFile file(QString::fromStdString(filename));
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "No se pudo abrir el archivo JSON";
-        return 1;
-    }
-
-    // Leer todo el contenido del archivo JSON
-    QByteArray jsonData = file.readAll();
-    file.close();
-
-    // Crear un QJsonDocument a partir de los datos leídos
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData, &error);
-
-    // Verificar errores de parseo
-    if (jsonDoc.isNull()) {
-        qWarning() << "Error al parsear el archivo JSON:" << error.errorString();
+    Campaign loaded;
+    int error = isBinaryCampaign(filename) ? readCampaignBinary(filename, loaded)
+                                           : readCampaignJson(filename, loaded);
+    if (error)
         return 1;
-    }
-
-    // Verificar si el documento es un objeto JSON
-    if (!jsonDoc.isObject()) {
-        qWarning() << "El archivo JSON no contiene un objeto JSON";
-        return 1;
-    }
-
-    // Obtener el objeto JSON completo
-    QJsonObject jsonObj = jsonDoc.object();
-
-    // Extraer valores del objeto JSON
-    QString programPath = jsonObj["program"].toString();
-    int expectedResult = jsonObj["expectedResult"].toInt();
-    int expectedInstructions = jsonObj["expectedInstructions"].toInt();
-    QJsonArray injectionsArray = jsonObj["injections"].toArray();
-
-    // Almacenar las inyecciones en un vector de vectores de enteros
-    std::vector<std::vector<int>> injections;
-    for (const auto& injection : injectionsArray) {
-        std::vector<int> injectionVec;
-        QJsonArray injectionArray = injection.toArray();
-        for (const auto& value : injectionArray) {
-            injectionVec.push_back(value.toInt());
-        }
-        injections.push_back(injectionVec);
-    }
-
-    // Imprimir los valores extraídos
-    qDebug() << "Campaña cargada";
 
-    // Iguala las variables a la campaña de la clase
-    campaign.expectedInstructions = expectedInstructions;
-    campaign.programPath = programPath;
-    campaign.expectedResult = expectedResult;
-    campaign.injections = injections;
+    std::cout << "Campaña cargada" << std::endl;
 
+    campaign = loaded;
     return 0;
 }
 
@@ -157,23 +140,33 @@ std::string Computer::showRegisters(){
     return ss.str();
 }
 
-// Genera otro string para el desensamblado. El desensamblado está en la
-// variable cpu.disassembly.
-std::string Computer::showDisassembly(){
-    std::string str = cpu.disassembly.back();   // Pop de una pila
-    return str;
+// Genera otro string para el desensamblado a partir del historial de la
+// CPU (cpu.history). Devuelve las instrucciones desde la número from (ver
+// InstructionHistory::pushed()), ya que en una ráfaga de ejecución se pueden
+// haber añadido varias. Las que ya no están en el historial se saltan
+std::string Computer::showDisassembly(uint64_t from){
+    std::stringstream ss;
+
+    uint64_t oldest = cpu.history.pushed() - cpu.history.size();   // Número de la más antigua guardada
+    size_t first = (from > oldest) ? from - oldest : 0;
+
+    for (size_t i = first; i < cpu.history.size(); ++i) {
+        if (i != first)
+            ss << "\n";
+        ss << CPU::disassemble(cpu.history.at(i).ir);
+    }
+
+    return ss.str();
 }
 
 // Función que exporta el desensamblado en un archivo de texto plano.
 // Esta función solo genera la cadena. La generación del archivo se hace en el archivo
 // mainwindow.cpp
 std::string Computer::exportDisassembly(){
-    std::vector<std::string> st = cpu.disassembly;
-
     std::stringstream ss;
 
-    for (size_t i = 0; i < st.size(); ++i) {
-        ss << st[i] << std::endl;
+    for (size_t i = 0; i < cpu.history.size(); ++i) {
+        ss << CPU::disassemble(cpu.history.at(i).ir) << std::endl;
     }
 
     return ss.str();
@@ -183,16 +176,16 @@ std::string Computer::exportDisassembly(){
 //      1. En cada línea de la terminal caben 75 caracteres.
 //      2. En la terminal, caben 20 lineas.
 //      3. La memoría I/O, que es la que lee la terminal, ocupa 1500 (guardada en ram.pIo)
-QString Computer::showVRAMLine(int line)
+std::string Computer::showVRAMLine(int line)
 {
-    QString lineString;
-    uint start = (line * 75) + (ram.iMemorySize - ram.pIo);
-    uint end = start + 75;
+    std::string lineString;
+    uint32_t start = (line * 75) + (ram.iMemorySize - ram.pIo);
+    uint32_t end = start + 75;
 
 
-    for (uint i = start; i < end; ++i) {
+    for (uint32_t i = start; i < end; ++i) {
         // Append a la variable lineString de lo que haya en memoria en esa posición
-        lineString += QChar(ram.readByte(i));
+        lineString += static_cast<char>(ram.readByte(i));
     }
 
 
@@ -2,45 +2,68 @@
 #define COMPUTER_H
 
 #include "cpu.h"
+#include "eventscheduler.h"
+#include "injections.h"
 #include "memory.h"
-#include <QTextEdit>
-#include <QPlainTextEdit>
+#include <memory>
+#include <string>
+#include <vector>
 
 struct Campaign {
-    QString programPath;
+    std::string programPath;
     int expectedResult;
-    int expectedInstructions;
-    std::vector<std::vector<int>> injections;
+    uint32_t expectedInstructions;
+    InjectionList injections;
+};
+
+// Estado del ordenador guardado con Computer::snapshot(). La memoria se
+// comparte con el ordenador hasta que se modifica
+struct ComputerSnapshot {
+    reg registers[32];
+    uint32_t pc;
+    uint32_t ir;
+    uint32_t cycles;
+    std::shared_ptr<const MemorySnapshot> ram;
 };
 
 class Computer {
 public:
-    Computer(int RAM_SIZE);
-    Computer(int RAM_SIZE, QTextEdit *termb);
+    Computer(uint32_t RAM_SIZE);
     ~Computer();
 
-    CPU cpu;
+    // La memoria va antes que la CPU: el constructor de la CPU guarda su
+    // dirección, así que tiene que estar construida
     Memory ram;
+    CPU cpu;
 
     // Variables para las campañas
     Campaign campaign;
     std::string programName;
 
-    QTextEdit *terminalBox;
-    QPlainTextEdit *ramBox;
-
     uint32_t ram_size;
 
+    // Condiciones de parada de las ejecuciones con run()
+    StopCondition stop;
+
+    // Eventos por ciclo. run() para en el ciclo del siguiente
+    EventScheduler events;
+
     void reset();
+    StopReason run(uint32_t budget);
+
+    // Guarda y restaura registros, PC, ciclos y memoria. Restaurar deja el
+    // resto de la CPU como después de un reset
+    ComputerSnapshot snapshot();
+    void restore(const ComputerSnapshot &snap);
     int LoadProgram(std::string filename);
     int LoadCampaign(std::string filename);
     int executeCampaign();
     std::string showRam(int page = 0);
     std::string showRegisters();
-    std::string showDisassembly();
+    std::string showDisassembly(uint64_t from);
     std::string exportDisassembly();
 
-    QString showVRAMLine(int line);
+    std::string showVRAMLine(int line);
 
 
 };
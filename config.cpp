@@ -0,0 +1,84 @@
+#include "config.h"
+#include "computer.h"
+#include "json.h"
+#include <iostream>
+
+int readConfig(const std::string &filename, EmulatorConfig &config){
+    JsonValue json;
+    std::string error;
+
+    if (readJsonFile(filename, json, &error) != 0) {
+        std::cerr << "Error al leer la configuración: " << error << std::endl;
+        return 1;
+    }
+
+    if (json.type != JsonValue::Type::Object) {
+        std::cerr << "El archivo JSON no contiene un objeto JSON" << std::endl;
+        return 1;
+    }
+
+    if (!json["ramSize"].isNull())
+        config.ramSize = static_cast<uint32_t>(json["ramSize"].toInt()) * 1024 * 1024 * 1024;
+
+    config.romAddressAllocation = json["romAddressAllocation"].toAddress(config.romAddressAllocation);
+    config.resultRamLocation = json["resultRamLocation"].toAddress(config.resultRamLocation);
+    config.finishRamLocation = json["finishRamLocation"].toAddress(config.finishRamLocation);
+
+    config.interpreterCore = json["interpreterCore"].toString(config.interpreterCore);
+    config.disassemblyHistory = json["disassemblyHistory"].toInt(config.disassemblyHistory);
+    if (config.disassemblyHistory < 0 || static_cast<size_t>(config.disassemblyHistory) > InstructionHistory::MAX_DEPTH) {
+        int limited = (config.disassemblyHistory < 0) ? 0 : static_cast<int>(InstructionHistory::MAX_DEPTH);
+        std::cerr << "disassemblyHistory fuera de rango (0 - " << InstructionHistory::MAX_DEPTH << "): "
+                  << config.disassemblyHistory << ", se usa " << limited << std::endl;
+        config.disassemblyHistory = limited;
+    }
+    config.campaignCheckpoints = json["campaignCheckpoints"].toInt(config.campaignCheckpoints);
+    config.campaignHashPoints = json["campaignHashPoints"].toInt(config.campaignHashPoints);
+    config.campaignLiveness = json["campaignLiveness"].toBool(config.campaignLiveness);
+    config.campaignThreads = json["campaignThreads"].toInt(config.campaignThreads);
+    config.campaignConfidence = json["campaignConfidence"].toDouble(config.campaignConfidence);
+    config.campaignMargin = json["campaignMargin"].toDouble(config.campaignMargin);
+    config.goldenLimit = json["goldenLimit"].toInt(config.goldenLimit);
+
+    config.disassemblyFileRoute = json["disassemblyFileRoute"].toString(config.disassemblyFileRoute);
+    config.ramFileRoute = json["ramFileRoute"].toString(config.ramFileRoute);
+    config.campaignGeneratorRoute = json["campaignGeneratorRoute"].toString(config.campaignGeneratorRoute);
+    config.goldenCacheRoute = json["goldenCacheRoute"].toString(config.goldenCacheRoute);
+
+    return 0;
+}
+
+bool parseCore(const std::string &name, CPU::Core &core){
+    if (name == "classic")
+        core = CPU::Core::Classic;
+    else if (name == "threaded")
+        core = CPU::Core::Threaded;
+    else if (name == "block")
+        core = CPU::Core::Block;
+    else if (name == "jit")
+        core = CPU::Core::Jit;
+    else
+        return false;
+
+    return true;
+}
+
+void applyConfig(const EmulatorConfig &config, Computer &computer){
+    computer.ram.iRomStartAddr = config.romAddressAllocation;  // Localización de la ROM
+
+    CPU::Core core = CPU::Core::Classic;
+    if (!parseCore(config.interpreterCore, core))
+        std::cerr << "Núcleo desconocido: " << config.interpreterCore << ", se usa classic" << std::endl;
+
+    // Solo el núcleo clásico guarda el historial del desensamblado
+    if (core != CPU::Core::Classic && config.disassemblyHistory > 0) {
+        std::cerr << "El núcleo " << config.interpreterCore << " no guarda el historial del desensamblado, "
+                  << "se usa classic (disassemblyHistory a 0 para usarlo)" << std::endl;
+        core = CPU::Core::Classic;
+    }
+    computer.cpu.core = core;
+
+    computer.cpu.history.setDepth(config.disassemblyHistory);  // Instrucciones que se guardan para el desensamblado
+
+    computer.stop.finishAddr = config.finishRamLocation;   // Al escribir aquí un 0 termina la ejecución
+}
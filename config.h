@@ -0,0 +1,49 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/*
+    Configuración del emulador (config.json). La usan tanto la interfaz como
+    kronos-cli. Los valores por defecto son los del config.json del repositorio.
+*/
+#include <cstdint>
+#include <string>
+#include "cpu.h"
+
+class Computer;
+
+struct EmulatorConfig {
+    uint32_t ramSize = 3u * 1024 * 1024 * 1024;     // En el archivo va en GB
+    uint32_t romAddressAllocation = 0x10000000;
+    uint32_t resultRamLocation = 0x15000000;
+    uint32_t finishRamLocation = 0x80003020;
+
+    std::string interpreterCore = "classic";
+    int disassemblyHistory = CPU::HISTORY_DEPTH;    // Entre 0 y InstructionHistory::MAX_DEPTH
+    int campaignCheckpoints = 64;
+    int campaignHashPoints = 1024;
+    bool campaignLiveness = true;
+    int campaignThreads = 0;
+    double campaignConfidence = 0;      // 0 para ejecutar todas las inyecciones
+    double campaignMargin = 0.01;
+    int goldenLimit = 1000000000;       // Instrucciones de la ejecución de referencia en la interfaz (0 sin límite)
+
+    std::string disassemblyFileRoute;
+    std::string ramFileRoute;
+    std::string campaignGeneratorRoute;
+    std::string goldenCacheRoute = "golden-cache";     // Vacío para no usar la caché (ver goldencache.h)
+};
+
+// Lee filename en config. Las claves que falten se quedan con su valor.
+// Devuelve 1 si el archivo no se puede leer o no es válido
+int readConfig(const std::string &filename, EmulatorConfig &config);
+
+// Traduce el nombre de un núcleo ("classic", "threaded", "block" o "jit").
+// Devuelve false si no existe
+bool parseCore(const std::string &name, CPU::Core &core);
+
+// Aplica a computer la ROM, el núcleo, el historial y la dirección de fin.
+// Solo el núcleo clásico guarda el historial, así que con disassemblyHistory
+// mayor que 0 se usa el clásico aunque interpreterCore diga otro
+void applyConfig(const EmulatorConfig &config, Computer &computer);
+
+#endif // CONFIG_H
@@ -0,0 +1,126 @@
+/*
+    Prueba de equivalencia de los núcleos del intérprete.
+
+    Ejecuta el programa de prueba con cada núcleo y compara con el clásico
+    los registros, el PC, los ciclos, el contenido de la memoria y el motivo
+    de parada. Con ráfagas de distintos tamaños, para que los núcleos que
+    ejecutan por bloques tengan que parar a mitad de uno, y con variantes
+    del programa que acaban en una excepción.
+*/
+#include "testprogram.h"
+#include <memory>
+
+static const uint32_t BURSTS[] = { 1, 7, 1000000 };
+
+struct RunState {
+    StopReason reason;
+    reg registers[32];
+    uint32_t pc;
+    uint32_t cycles;
+    uint64_t memory;
+    Trap trap;
+    uint32_t trapPc;
+    uint32_t trapAddr;
+};
+
+// Cómo se ejecuta el programa: con run() en ráfagas de burst instrucciones,
+// instrucción a instrucción con clock(), como el botón de paso a paso, o
+// directamente con runInstructions(), que no convierte los accesos fuera de
+// la memoria en excepciones ni mueve el PC después de ejecutar
+enum class Driver { Run, Clock, Instructions };
+
+static RunState runCore(const std::vector<uint32_t> &program, CPU::Core core, uint32_t burst, Driver driver = Driver::Run){
+    Memory ram(TEST_MEMORY_SIZE);
+    std::unique_ptr<CPU> cpu(new CPU(&ram));
+    cpu->core = core;
+    loadTest(ram, *cpu, program);
+
+    RunState state;
+    if (driver == Driver::Run) {
+        StopCondition stop;
+        stop.finishAddr = TEST_FINISH_ADDR;
+
+        state.reason = StopReason::Budget;
+        while (state.reason == StopReason::Budget && cpu->cycles < TEST_LIMIT)
+            state.reason = cpu->run(burst, stop);
+    } else if (driver == Driver::Clock) {
+        while (cpu->trap == Trap::None && ram.readByte(TEST_FINISH_ADDR) != 0 && cpu->cycles < TEST_LIMIT)
+            cpu->clock();
+        state.reason = (cpu->trap != Trap::None) ? StopReason::Trap : StopReason::Finished;
+    } else {
+        ram.iWatchAddr = TEST_FINISH_ADDR;
+        state.reason = StopReason::Budget;
+        while (state.reason == StopReason::Budget && cpu->cycles < TEST_LIMIT) {
+            uint32_t n = TEST_LIMIT - cpu->cycles;
+            cpu->runInstructions(n < burst ? n : burst);
+            if (cpu->trap != Trap::None || ram.fault != Memory::Fault::None)
+                state.reason = StopReason::Trap;
+            else if (ram.bWatchHit && ram.readByte(TEST_FINISH_ADDR) == 0)
+                state.reason = StopReason::Finished;
+        }
+    }
+
+    for (int i = 0; i < 32; i++)
+        state.registers[i] = cpu->registers[i];
+    state.pc = cpu->pc;
+    state.cycles = cpu->cycles;
+    state.memory = memoryHash(ram);
+    state.trap = cpu->trap;
+    state.trapPc = cpu->trapPc;
+    state.trapAddr = cpu->trapAddr;
+
+    ram.pICache = nullptr;
+    return state;
+}
+
+// Compara con la ejecución del núcleo clásico
+static void compare(const RunState &a, const RunState &b, const std::string &what){
+    check(a.reason == b.reason, what + ": motivo de parada distinto");
+    for (int i = 0; i < 32; i++)
+        check(a.registers[i] == b.registers[i], what + ": x" + std::to_string(i) + " distinto");
+    check(a.pc == b.pc, what + ": PC distinto");
+    check(a.cycles == b.cycles, what + ": ciclos distintos");
+    check(a.memory == b.memory, what + ": memoria distinta");
+    check(a.trap == b.trap && a.trapPc == b.trapPc && a.trapAddr == b.trapAddr, what + ": excepción distinta");
+}
+
+static void testVariant(const std::vector<uint32_t> &program, const std::string &variant, StopReason expected){
+    RunState reference = runCore(program, CPU::Core::Classic, BURSTS[0]);
+    check(reference.reason == expected, variant + ": el núcleo clásico no para como se esperaba");
+    RunState instructions = runCore(program, CPU::Core::Classic, BURSTS[0], Driver::Instructions);
+
+    for (const auto &core : TEST_CORES) {
+        for (uint32_t burst : BURSTS) {
+            std::string what = variant + ", " + core.name + ", ráfagas de " + std::to_string(burst);
+            compare(runCore(program, core.core, burst), reference, what);
+            compare(runCore(program, core.core, burst, Driver::Instructions), instructions, what + " sin run()");
+        }
+    }
+
+    compare(runCore(program, CPU::Core::Classic, 1, Driver::Clock), reference, variant + ", paso a paso");
+}
+
+int main(){
+    std::vector<uint32_t> program = testProgram();
+    testVariant(program, "programa", StopReason::Finished);
+
+    // Al salir del bucle, una instrucción que no existe
+    std::vector<uint32_t> illegal = program;
+    illegal[21] = 0xFFFFFFFF;
+    testVariant(illegal, "instrucción no válida", StopReason::Trap);
+
+    // Una lectura y una escritura fuera de la memoria
+    std::vector<uint32_t> load = program;
+    load[21] = encodeI(-4, ZERO, 2, A0, 0x03);     // lw a0, -4(zero)
+    testVariant(load, "lectura fuera de la memoria", StopReason::Trap);
+
+    std::vector<uint32_t> store = program;
+    store[22] = encodeS(-4, S1, ZERO, 2);           // sw s1, -4(zero)
+    testVariant(store, "escritura fuera de la memoria", StopReason::Trap);
+
+    if (testFailures > 0)
+        return 1;
+
+    std::cout << "Núcleos: correcto" << std::endl;
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include "cpu.h"
-#include "endian.h"
+#include "isa.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -15,10 +16,12 @@ CPU::CPU(Memory *ram){
 
     this->ram = ram;    // Puntero a la RAM
 
-    instDecoded.inmediate = 0;
-    instDecoded.op = -1;
+    history.setDepth(HISTORY_DEPTH);
 
-    for (int i = 0; i < 40; i++) {
+    instDecoded = {};
+    instDecoded.op = Operation::NOP;
+
+    for (int i = 0; i <= Operation::NOP; i++) {
         ciclosTotales[i] = 0;
     }
 
@@ -27,58 +30,10 @@ CPU::CPU(Memory *ram){
     }
 
 
-    // Inicialización del vector de funciones
-    vFunctionMap[Operation::ADD] = &CPU::ADD;
-    vFunctionMap[Operation::SUB] = &CPU::SUB;
-    vFunctionMap[Operation::XOR] = &CPU::XOR;
-    vFunctionMap[Operation::OR] = &CPU::OR;
-    vFunctionMap[Operation::AND] = &CPU::AND;
-    vFunctionMap[Operation::SLL] = &CPU::SLL;
-    vFunctionMap[Operation::SRL] = &CPU::SRL;
-    vFunctionMap[Operation::SRA] = &CPU::SRA;
-    vFunctionMap[Operation::SLT] = &CPU::SLT;
-    vFunctionMap[Operation::SLTU] = &CPU::SLTU;
-
-    // Formato I
-    vFunctionMap[Operation::ADDI] = &CPU::ADDI;
-    vFunctionMap[Operation::XORI] = &CPU::XORI;
-    vFunctionMap[Operation::ORI] = &CPU::ORI;
-    vFunctionMap[Operation::ANDI] = &CPU::ANDI;
-    vFunctionMap[Operation::SLLI] = &CPU::SLLI;
-    vFunctionMap[Operation::SRLI] = &CPU::SRLI;
-    vFunctionMap[Operation::SRAI] = &CPU::SRAI;
-    vFunctionMap[Operation::SLTI] = &CPU::SLTI;
-    vFunctionMap[Operation::SLTIU] = &CPU::SLTIU;
-    vFunctionMap[Operation::LB] = &CPU::LB;
-    vFunctionMap[Operation::LH] = &CPU::LH;
-    vFunctionMap[Operation::LW] = &CPU::LW;
-    vFunctionMap[Operation::LBU] = &CPU::LBU;
-    vFunctionMap[Operation::LHU] = &CPU::LHU;
-
-    vFunctionMap[Operation::JALR] = &CPU::JALR;
-    vFunctionMap[Operation::ECALL] = &CPU::ECALL;
-    vFunctionMap[Operation::EBREAK] = &CPU::EBREAK;
-
-    // Formato S
-    vFunctionMap[Operation::SB] = &CPU::SB;
-    vFunctionMap[Operation::SH] = &CPU::SH;
-    vFunctionMap[Operation::SW] = &CPU::SW;
-
-    // Formato B
-    vFunctionMap[Operation::BEQ] = &CPU::BEQ;
-    vFunctionMap[Operation::BNE] = &CPU::BNE;
-    vFunctionMap[Operation::BLT] = &CPU::BLT;
-    vFunctionMap[Operation::BGE] = &CPU::BGE;
-    vFunctionMap[Operation::BLTU] = &CPU::BLTU;
-    vFunctionMap[Operation::BGEU] = &CPU::BGEU;
-
-    // Formato J
-    vFunctionMap[Operation::JAL] = &CPU::JAL;
-
-    // Formato U
-    vFunctionMap[Operation::LUI] = &CPU::LUI;
-    vFunctionMap[Operation::AUIPC] = &CPU::AUIPC;
-
+    // Inicialización del vector de funciones a partir de la descripción de
+    // la ISA. Las codificaciones que no encajan con ninguna entrada son NOP
+    for (const IsaEntry &entry : ISA)
+        vFunctionMap[entry.op] = entry.handler;
     vFunctionMap[Operation::NOP] = &CPU::NOP;
 }
 
@@ -86,9 +41,18 @@ CPU::~CPU(){}
 
 // Función que se encarga de realizar un ciclo de reloj
 void CPU::clock(){
-    fetch();    // Extracción de la instrucción
+    ram->fault = Memory::Fault::None;
+    prepareStats();
+    dispatchStats(stats, [this](auto policy) { step<decltype(policy)>(); });
+    takeTrap();
+}
 
-    decode();   // Decodificación de la instrucción
+// Un ciclo de reloj contando las estadísticas que pide la política Stats
+template <class Stats>
+inline void CPU::step(){
+    decode();   // Extracción (si no está ya en caché) y decodificación de la instrucción
+
+    Stats::count(*this, pc, instDecoded.op, instDecoded.tipo);
 
     if(execute() == 0)  // Ejecución de la instrucción
         pc += 4;        // Si no es un salto, PC + 4
@@ -96,6 +60,110 @@ void CPU::clock(){
     cycles++;   // Sumamos uno al contador de ciclos
 }
 
+template <class Stats>
+uint32_t CPU::runClassic(uint32_t n){
+    uint32_t executed = 0;
+    while (executed < n) {
+        step<Stats>();
+        executed++;
+
+        if (ram->bWatchHit || bEbreak || trap != Trap::None)  // Dirección vigilada, EBREAK o excepción
+            break;
+    }
+
+    return executed;
+}
+
+void CPU::prepareStats(){
+    if (stats == StatsLevel::PerPc && ciclosPc.size() != icache.entries.size())
+        ciclosPc.assign(icache.entries.size(), 0);
+}
+
+
+// Ejecuta hasta n instrucciones seguidas con el núcleo seleccionado
+uint32_t CPU::runInstructions(uint32_t n){
+    ram->bWatchHit = false;
+    ram->fault = Memory::Fault::None;
+    bEbreak = false;
+    prepareStats();
+
+    if (core == Core::Threaded)
+        return runThreaded(n);
+
+    if (core == Core::Block || core == Core::Jit) {
+        // Sin JIT para esta plataforma se queda en el motor de bloques
+        blockEngine.bUseJit = (core == Core::Jit);
+        return blockEngine.run(*this, n);
+    }
+
+    return dispatchStats(stats, [this, n](auto policy) { return runClassic<decltype(policy)>(n); });
+}
+
+bool CPU::takeTrap(){
+    // Un acceso fuera de la memoria para justo después de la instrucción,
+    // que no es un salto: se vuelve a ella
+    if (ram->fault != Memory::Fault::None) {
+        trap = (ram->fault == Memory::Fault::Load) ? Trap::LoadFault : Trap::StoreFault;
+        trapAddr = ram->iFaultAddr;
+        trapPc = pc - 4;
+        ram->fault = Memory::Fault::None;
+    }
+
+    if (trap == Trap::None)
+        return false;
+
+    pc = trapPc;
+    return true;
+}
+
+// Ejecuta hasta budget instrucciones o hasta que se cumpla alguna de las
+// condiciones de parada. Las instrucciones se ejecutan en ráfagas con
+// runInstructions, así que solo se comprueba entre ráfagas
+StopReason CPU::run(uint32_t budget, const StopCondition &stop){
+    // Después de una excepción no se sigue ejecutando
+    if (trap != Trap::None)
+        return StopReason::Trap;
+
+    ram->iWatchAddr = stop.finishAddr;
+
+    // Al escribir un 0 en la dirección de fin el programa ha terminado
+    if (stop.finishAddr != StopCondition::NONE && ram->readByte(stop.finishAddr) == 0)
+        return StopReason::Finished;
+
+    uint32_t executed = 0;
+
+    while (true) {
+        if (cycles == stop.eventCycle)
+            return StopReason::Event;
+
+        if (executed >= budget)
+            return StopReason::Budget;
+
+        // La ráfaga termina justo antes de la instrucción del evento
+        uint32_t n = budget - executed;
+        if (stop.eventCycle > cycles && stop.eventCycle - cycles < n)
+            n = stop.eventCycle - cycles;
+
+        // Con puntos de parada se comprueba el PC después de cada instrucción
+        if (!stop.breakpoints.empty())
+            n = 1;
+
+        executed += runInstructions(n);
+
+        if (takeTrap())
+            return StopReason::Trap;
+
+        if (ram->bWatchHit && ram->readByte(stop.finishAddr) == 0)
+            return StopReason::Finished;
+
+        if (bEbreak && stop.bStopOnEbreak)
+            return StopReason::Ebreak;
+
+        if (!stop.breakpoints.empty() && std::binary_search(stop.breakpoints.begin(), stop.breakpoints.end(), pc))
+            return StopReason::Breakpoint;
+    }
+}
+
 
 // Función que resetea la CPU
 void CPU::reset(){
@@ -107,10 +175,10 @@ void CPU::reset(){
 
     registers[2] = ram->iMemorySize - ram->pIo - 1; // Puntero stack
 
-    instDecoded.inmediate = 0;
-    instDecoded.op = -1;
+    instDecoded = {};
+    instDecoded.op = Operation::NOP;
 
-    for (int i = 0; i < 39; i++) {
+    for (int i = 0; i <= Operation::NOP; i++) {
         ciclosTotales[i] = 0;
     }
 
@@ -118,7 +186,9 @@ void CPU::reset(){
         ciclosTipo[i] = 0;
     }
 
-    disassembly.clear();    // Vacía todo el registro de desensamblado
+    ciclosPc.assign(ciclosPc.size(), 0);
+
+    history.clear();    // Vacía todo el historial del desensamblado
 
     pc = ram->iRomStartAddr;    // PC apunta al inicio del programa (memoria ROM)
     ir = 0; // Reset del registro IR
@@ -126,135 +196,140 @@ void CPU::reset(){
     cycles = 0;
 
     bEbreak = 0;
+    trap = Trap::None;
 }
 
 // Captura de la instrucción
 void CPU::fetch(){
-    ir = FlipWord(ram->readWord(pc));
+    ir = ram->readWord(pc);
 }
 
 // Decodificación de la instrucción
 void CPU::decode() {
-    std::stringstream instDisassembled;
+    // Si la instrucción ya está decodificada en la caché no hace falta
+    // ni leerla de memoria
+    PredecodedInst uncached;
+    PredecodedInst *entry = fetchDecoded(pc, &uncached);
 
-    // Recoge el opcode (últimos 7 bits)
-    uint32_t opcode = ir & 0x7F;
+    ir = entry->ir;
 
-    switch (opcode)
-    {
-    case 0b00110011:    // R
-        instDecoded = decode_R(ir); // Recoge la instrucción decodificada y la guarda en la variable global de la clase
-
-        // Esto es para que, si es una operación no registrada, no imprima los registros
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", X" << instDecoded.registers[1] << ", X" << instDecoded.registers[2];
-            ciclosTipo[0]++;
-        }
+    // Se carga la instrucción en instDecoded para las funciones de ejecución
+    instDecoded.op = entry->op;
+    instDecoded.rd = entry->rd;
+    instDecoded.rs1 = entry->rs1;
+    instDecoded.rs2 = entry->rs2;
+    instDecoded.inmediate = entry->inmediate;
+    instDecoded.tipo = entry->tipo;
 
-        break;
-    case 0b00010011:    // I
-        instDecoded = decode_I(ir, 0);
+    history.push(pc, ir);   // El desensamblado se genera después, si se pide
+}
 
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", X" << instDecoded.registers[1] << ", " << instDecoded.inmediate;
-            ciclosTipo[1]++;
-        }
+// Genera el texto del desensamblado de una instrucción
+std::string CPU::disassemble(uint32_t ir){
+    PredecodedInst inst = predecode(ir);
+    std::stringstream instDisassembled;
 
-        break;
-    case 0b00000011:    // I
-        instDecoded = decode_I(ir, 1);
+    // Esto es para que, si es una operación no registrada, no imprima los registros
+    if (inst.op == Operation::NOP) {
+        if (inst.tipo == 0xFF)    // El opcode no existe
+            instDisassembled << "NOP";
+        return instDisassembled.str();
+    }
 
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", X" << instDecoded.registers[1] << ", " << instDecoded.inmediate;
-            ciclosTipo[1]++;
-        }
+    Decoded dec = { inst.op, inst.rd, inst.rs1, inst.rs2, inst.inmediate, inst.tipo };
+    instDisassembled << formatDissasembly(dec);
 
+    // Los registros son uint8_t: se pasan a int para que no se impriman como caracteres
+    int rd = dec.rd, rs1 = dec.rs1, rs2 = dec.rs2;
 
+    switch (inst.tipo)
+    {
+    case 0:     // R
+        instDisassembled << rd << ", X" << rs1 << ", X" << rs2;
         break;
-    case 0b00100011:    // S
-        instDecoded = decode_S(ir);
-
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[1] << ", " << instDecoded.inmediate << "(X" << instDecoded.registers[0] << ")";
-            ciclosTipo[2]++;
-        }
-
+    case 1:     // I
+        instDisassembled << rd << ", X" << rs1 << ", " << dec.inmediate;
         break;
-    case 0b01100011:    // B
-        instDecoded = decode_B(ir);
-
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", X" << instDecoded.registers[1] << ", " << instDecoded.inmediate;
-            ciclosTipo[3]++;
-        }
-
+    case 3:     // B
+        instDisassembled << rs1 << ", X" << rs2 << ", " << dec.inmediate;
         break;
-    case 0b01101111:    // J
-        instDecoded = decode_J(ir);
-
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", " << instDecoded.inmediate;
-            ciclosTipo[5]++;
-        }
-
-
+    case 2:     // S
+        instDisassembled << rs2 << ", " << dec.inmediate << "(X" << rs1 << ")";
         break;
-    case 0b01100111:    // I
-        instDecoded = decode_I(ir, 2);
+    default:    // U y J
+        instDisassembled << rd << ", " << dec.inmediate;
+        break;
+    }
 
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", X" << instDecoded.registers[1] << ", " << instDecoded.inmediate;
-            ciclosTipo[1]++;
-        }
+    return instDisassembled.str();
+}
 
-        break;
-    case 0b00110111:    // U
-        instDecoded = decode_U(ir, 0);
+// Busca la instrucción de addr en la caché. Si no está, la lee de memoria
+// y la decodifica
+PredecodedInst* CPU::fetchDecoded(uint32_t addr, PredecodedInst *scratch) {
+    PredecodedInst *entry = icache.lookup(addr);
+    if (entry != nullptr && entry->valid)
+        return entry;
 
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", " << instDecoded.inmediate;
-            ciclosTipo[4]++;
-        }
+    // Fuera del programa cargado, o en una dirección no alineada, no hay
+    // instrucción: se devuelve la 0, que no es válida, para que al ejecutarla
+    // salte la excepción (ver illegalInstruction())
+    if (entry == nullptr) {
+        *scratch = predecode(0);
+        return scratch;
+    }
 
-        break;
-    case 0b00010111:    // U
-        instDecoded = decode_U(ir, 1);
+    *entry = predecode(ram->readWord(addr));
+    return entry;
+}
 
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", " << instDecoded.inmediate;
-            ciclosTipo[4]++;
-        }
+bool CPU::illegalInstruction(uint32_t pc){
+    PredecodedInst scratch;
+    const PredecodedInst *inst = fetchDecoded(pc, &scratch);
 
-        break;
-    case 0b01110011:    // I
-        instDecoded = decode_I(ir, 3);
+    if (isFence(inst->ir))
+        return false;
 
-        if(instDecoded.op != Operation::NOP){
-            instDisassembled << formatDissasembly(instDecoded);
-            instDisassembled << instDecoded.registers[0] << ", X" << instDecoded.registers[1] << ", " << instDecoded.inmediate;
-            ciclosTipo[1]++;
-        }
+    if ((pc & 0x3) != 0)
+        trap = Trap::MisalignedFetch;
+    else if (icache.lookup(pc) == nullptr)
+        trap = Trap::FetchFault;
+    else
+        trap = Trap::IllegalInstruction;
 
-        break;
-    default:
-        instDisassembled << "NOP";
-        instDecoded.mnemonic = "NOP";
-        instDecoded.op = Operation::NOP;
-        break;
+    trapPc = pc;
+    trapAddr = pc;
+    return true;
+}
+
+const char* trapName(Trap trap){
+    switch (trap)
+    {
+    case Trap::IllegalInstruction: return "Instrucción no válida";
+    case Trap::FetchFault:         return "Captura fuera del programa";
+    case Trap::MisalignedFetch:    return "Salto no alineado";
+    case Trap::LoadFault:          return "Lectura fuera de la memoria";
+    case Trap::StoreFault:         return "Escritura fuera de la memoria";
+    default:                       return "Ninguna";
     }
+}
 
-    disassembly.push_back(instDisassembled.str());  // Guarda el desensamblado de la instrucción
+// Decodifica una instrucción completa y la deja en el formato de la caché.
+// Solo se llama la primera vez que se ejecuta cada dirección
+PredecodedInst CPU::predecode(uint32_t ir) {
+    Decoded dec = decodeInstruction(ir);
 
-    instDisassembled.clear();
+    PredecodedInst inst = {};
+    inst.ir = ir;
+    inst.op = dec.op;
+    inst.tipo = dec.tipo;
+    inst.inmediate = dec.inmediate;
+    inst.rd = dec.rd;
+    inst.rs1 = dec.rs1;
+    inst.rs2 = dec.rs2;
+    inst.valid = 1;
+
+    return inst;
 }
 
 // Ejecuta un ciclo de instrucción
@@ -263,8 +338,6 @@ int CPU::execute() {
     // Se ejecuta la función almacenada en instDecoded
     int iIsJump = (this->*vFunctionMap[instDecoded.op])();
 
-    ciclosTotales[instDecoded.op]++;
-
     return iIsJump;
 }
 
@@ -278,82 +351,82 @@ int CPU::execute() {
 // R format
 int CPU::ADD(){
     // Suma dos variables y lo guarda en RD
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     registers[rd] = registers[rs1] + registers[rs2];
 
     return 0;
 }
 int CPU::SUB() {
     // resta dos variables y lo guarda en RD
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     registers[rd] = registers[rs1] - registers[rs2];
 
     return 0;
 }
 int CPU::XOR() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     registers[rd] = registers[rs1] ^ registers[rs2];
 
     return 0;
 }
 int CPU::OR() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     registers[rd] = registers[rs1] | registers[rs2];
 
     return 0;
 }
 int CPU::AND() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     registers[rd] = registers[rs1] & registers[rs2];
 
     return 0;
 }
 int CPU::SLL() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
-    registers[rd] = static_cast<uint32_t>(registers[rs1]) << registers[rs2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
+    registers[rd] = static_cast<uint32_t>(registers[rs1]) << (registers[rs2] & 0b11111);
 
     return 0;
 }
 int CPU::SRL() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
-    registers[rd] = static_cast<uint32_t>( registers[rs1] ) >> registers[rs2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
+    registers[rd] = static_cast<uint32_t>( registers[rs1] ) >> (registers[rs2] & 0b11111);
 
     return 0;
 }
 int CPU::SRA() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
-    registers[rd] = registers[rs1] >> registers[rs2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
+    registers[rd] = registers[rs1] >> (registers[rs2] & 0b11111);
 
     return 0;
 }
 int CPU::SLT() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     registers[rd] = (registers[rs1] < registers[rs2]) ? 1 : 0;
 
     return 0;
 }
 int CPU::SLTU() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t rs2 = instDecoded.registers[2];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     registers[rd] = (static_cast<uint32_t>(registers[rs1]) < static_cast<uint32_t>(registers[rs2])) ? 1 : 0;
 
     return 0;
@@ -361,8 +434,8 @@ int CPU::SLTU() {
 
 // I format
 int CPU::ADDI() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = registers[rs1] + inmediate;
@@ -370,8 +443,8 @@ int CPU::ADDI() {
     return 0;
 }
 int CPU::XORI() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = registers[rs1] ^ inmediate;
@@ -379,8 +452,8 @@ int CPU::XORI() {
     return 0;
 }
 int CPU::ORI() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = registers[rs1] | inmediate;
@@ -388,8 +461,8 @@ int CPU::ORI() {
     return 0;
 }
 int CPU::ANDI() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = registers[rs1] & inmediate;
@@ -397,8 +470,8 @@ int CPU::ANDI() {
     return 0;
 }
 int CPU::SLLI() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = static_cast<uint32_t>(registers[rs1]) << (static_cast<uint32_t>(inmediate) & 0b11111);
@@ -406,8 +479,8 @@ int CPU::SLLI() {
     return 0;
 }
 int CPU::SRLI() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = static_cast<uint32_t>(registers[rs1]) >> (static_cast<uint32_t>(inmediate) & 0b11111);
@@ -415,8 +488,8 @@ int CPU::SRLI() {
     return 0;
 }
 int CPU::SRAI() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = registers[rs1] >> (inmediate & 0b11111);
@@ -424,25 +497,25 @@ int CPU::SRAI() {
     return 0;
 }
 int CPU::SLTI() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
     registers[rd] = (registers[rs1] < inmediate) ? 1 : 0;
 
     return 0;
 }
 int CPU::SLTIU() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
-    uint8_t inmediate = instDecoded.inmediate;
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
+    int32_t inmediate = instDecoded.inmediate;
     registers[rd] = (static_cast<uint32_t>(registers[rs1]) < static_cast<uint32_t>(inmediate)) ? 1 : 0;
 
     return 0;
 }
 
 int CPU::LB() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     /* La lógica de esto es la siguiente:
@@ -467,25 +540,26 @@ int CPU::LB() {
     return 0;
 }
 int CPU::LH() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
-    int16_t half = FlipHalf(ram->readHalf(registers[rs1] + inmediate));
+    int16_t half = ram->readHalf(registers[rs1] + inmediate);
 
-    return 0;
     registers[rd] = half;
+
+    return 0;
 }
 int CPU::LW() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
-    registers[rd] = FlipWord(ram->readWord(registers[rs1] + inmediate));
+    registers[rd] = ram->readWord(registers[rs1] + inmediate);
 
     return 0;
 }
 int CPU::LBU() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     // En este caso, al ser un unsigned, con hacer el AND ya
@@ -496,29 +570,32 @@ int CPU::LBU() {
     return 0;
 }
 int CPU::LHU() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     int32_t inmediate = instDecoded.inmediate;
 
     // En este caso, al ser un unsigned, con hacer el AND ya
     // saca el valor adecuado
 
-    registers[rd] = FlipHalf(ram->readHalf(registers[rs1] + inmediate));
+    registers[rd] = ram->readHalf(registers[rs1] + inmediate);
 
     return 0;
 }
 
 int CPU::JALR() {
-    uint8_t rd = instDecoded.registers[0];
-    uint8_t rs1 = instDecoded.registers[1];
+    uint8_t rd = instDecoded.rd;
+    uint8_t rs1 = instDecoded.rs1;
     uint32_t inmediate = instDecoded.inmediate;
 
     // La dirección que tocaría si no se hiciera el salto se guarda en rd
     // para saltar más adelante de vuelta
 
+    // El destino se calcula antes de escribir rd, que puede ser el mismo que rs1
+    uint32_t target = registers[rs1] + inmediate;
+
     if(rd != 0)
         registers[rd] = pc + 4;
-    pc = registers[rs1] + inmediate;
+    pc = target;
 
     return 1;
 }
@@ -536,8 +613,8 @@ int CPU::EBREAK() {
 
 // S format
 int CPU::SB() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
     uint8_t toStore = (registers[rs2] & 0xFF);
@@ -547,23 +624,22 @@ int CPU::SB() {
     return 0;
 }
 int CPU::SH() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
     uint16_t toStore = (registers[rs2] & 0xFFFF);
-    toStore = FlipHalf(toStore);
 
     ram->writeHalf(registers[rs1] + inmediate, toStore);
 
     return 0;
 }
 int CPU::SW() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
-    uint32_t toStore = FlipWord(registers[rs2]);
+    uint32_t toStore = registers[rs2];
 
     ram->writeWord(registers[rs1] + inmediate, toStore);
 
@@ -572,8 +648,8 @@ int CPU::SW() {
 
 // B format
 int CPU::BEQ() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
     if (registers[rs1] == registers[rs2]){
@@ -583,8 +659,8 @@ int CPU::BEQ() {
         return 0;
 }
 int CPU::BNE() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
     if (registers[rs1] != registers[rs2]){
@@ -594,8 +670,8 @@ int CPU::BNE() {
         return 0;
 }
 int CPU::BLT() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
     if (registers[rs1] < registers[rs2]){
@@ -605,8 +681,8 @@ int CPU::BLT() {
         return 0;
 }
 int CPU::BGE() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
     if (registers[rs1] >= registers[rs2]){
@@ -616,8 +692,8 @@ int CPU::BGE() {
         return 0;
 }
 int CPU::BLTU() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
     if (static_cast<uint32_t>(registers[rs1]) < static_cast<uint32_t>(registers[rs2])){
@@ -627,8 +703,8 @@ int CPU::BLTU() {
         return 0;
 }
 int CPU::BGEU() {
-    uint8_t rs1 = instDecoded.registers[0];
-    uint8_t rs2 = instDecoded.registers[1];
+    uint8_t rs1 = instDecoded.rs1;
+    uint8_t rs2 = instDecoded.rs2;
     uint32_t inmediate = instDecoded.inmediate;
 
     if (static_cast<uint32_t>(registers[rs1]) >= static_cast<uint32_t>(registers[rs2])){
@@ -640,7 +716,7 @@ int CPU::BGEU() {
 
 // J format
 int CPU::JAL() {
-    uint8_t rd = instDecoded.registers[0];
+    uint8_t rd = instDecoded.rd;
     uint32_t inmediate = instDecoded.inmediate;
 
     // La dirección que tocaría si no se hiciera el salto se guarda en rd
@@ -654,7 +730,7 @@ int CPU::JAL() {
 
 // U format
 int CPU::LUI() {
-    uint8_t rd = instDecoded.registers[0];
+    uint8_t rd = instDecoded.rd;
     uint32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = inmediate << 12;
@@ -662,7 +738,7 @@ int CPU::LUI() {
     return 0;
 }
 int CPU::AUIPC() {
-    uint8_t rd = instDecoded.registers[0];
+    uint8_t rd = instDecoded.rd;
     uint32_t inmediate = instDecoded.inmediate;
 
     registers[rd] = pc + (inmediate << 12);
@@ -671,6 +747,9 @@ int CPU::AUIPC() {
 }
 
 int CPU::NOP(){
+    if (illegalInstruction(pc))
+        return 1;   // El PC se queda en la instrucción
+
     return 0;
 }
 
@@ -678,13 +757,15 @@ int CPU::NOP(){
 // Formatea el desensamblado para imprimirlo y que queden
 // todos los registros a la misma altura
 std::string CPU::formatDissasembly(Decoded inst){
+    std::string mnemonic = mnemonics[inst.op];
+
     std::stringstream st;
-    st << inst.mnemonic;
-    if(inst.mnemonic.length() == 2)
+    st << mnemonic;
+    if(mnemonic.length() == 2)
         st <<  "    X";
-    else if(inst.mnemonic.length() == 3)
+    else if(mnemonic.length() == 3)
         st << "   X";
-    else if(inst.mnemonic.length() == 4)
+    else if(mnemonic.length() == 4)
         st << "  X";
     else
         st << " X";
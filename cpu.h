@@ -8,9 +8,47 @@
 #include <string>
 #include "decoder.h"
 #include "memory.h"
+#include "icache.h"
+#include "blockengine.h"
+#include "history.h"
+#include "stats.h"
 
 using reg = int32_t;
 
+// Motivo por el que ha parado CPU::run
+enum class StopReason {
+    Finished,       // Se ha escrito un 0 en la dirección de fin
+    Ebreak,         // Se ha ejecutado un EBREAK
+    Budget,         // Se han ejecutado todas las instrucciones pedidas
+    Breakpoint,     // El PC ha llegado a un punto de parada
+    Event,          // Ha llegado el ciclo del siguiente evento (ver eventscheduler.h)
+    Trap            // Ha saltado una excepción (ver CPU::trap)
+};
+
+// Excepciones que paran la ejecución. La instrucción que la provoca cuenta
+// como ejecutada, pero el PC se queda en ella
+enum class Trap : uint8_t {
+    None,
+    IllegalInstruction, // Codificación que no existe (FENCE sigue sin hacer nada)
+    FetchFault,         // El PC está fuera del programa cargado
+    MisalignedFetch,    // El PC no es múltiplo de 4 (se detecta al llegar al destino del salto)
+    LoadFault,          // Lectura fuera de la memoria
+    StoreFault          // Escritura fuera de la memoria
+};
+
+// Nombre de la excepción para mostrarlo
+const char* trapName(Trap trap);
+
+// Condiciones con las que para CPU::run
+struct StopCondition {
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    uint32_t finishAddr = NONE;         // Dirección de fin del programa
+    bool bStopOnEbreak = false;
+    std::vector<uint32_t> breakpoints;  // PCs ordenados. Se para antes de ejecutarlos
+    uint32_t eventCycle = NONE;         // Se para cuando cycles llega a este valor
+};
+
 class CPU {
 public:
     CPU(Memory *ram);
@@ -20,6 +58,18 @@ public:
     bool bEbreak = false;
     uint32_t cycles = 0;
 
+    // Excepción pendiente, con la instrucción que la ha provocado y la
+    // dirección a la que quería acceder (el propio PC en las de captura).
+    // Mientras haya una, run() para sin ejecutar nada hasta el reset
+    Trap trap = Trap::None;
+    uint32_t trapPc = 0;
+    uint32_t trapAddr = 0;
+
+    // Se llama al ejecutar una instrucción decodificada como NOP. Si es
+    // FENCE no hace nada y devuelve false; si no, apunta la excepción que
+    // corresponda a pc y devuelve true
+    bool illegalInstruction(uint32_t pc);
+
     // Fetch siguiente instrucción
     void fetch();
     void decode();
@@ -34,12 +84,58 @@ public:
 
     Decoded instDecoded;
 
-    std::vector<std::string> disassembly;
-    std::string formatDissasembly(Decoded inst);
+    // Caché de instrucciones predecodificadas de la ROM
+    InstructionCache icache;
+    static PredecodedInst predecode(uint32_t ir);
+
+    // Devuelve la instrucción de addr decodificada. Si addr está fuera de la ROM
+    // se decodifica en scratch sin guardarla en la caché
+    PredecodedInst* fetchDecoded(uint32_t addr, PredecodedInst *scratch);
+
+    // Últimas instrucciones ejecutadas por el núcleo clásico (PC e IR). El
+    // desensamblado se genera con disassemble() solo cuando se muestra
+    static const size_t HISTORY_DEPTH = 100000;
+    InstructionHistory history;
+
+    static std::string disassemble(uint32_t ir);
+    static std::string formatDissasembly(Decoded inst);
 
     void clock();
     void reset();
 
+    // Núcleo con el que se ejecutan las ráfagas de instrucciones. El clásico
+    // llama a clock() por cada instrucción; el threaded salta directamente
+    // de una instrucción a la siguiente con una tabla de saltos, el de
+    // bloques ejecuta bloques básicos ya traducidos y encadenados, y el JIT
+    // además compila a código nativo los bloques más ejecutados
+    enum class Core { Classic, Threaded, Block, Jit };
+    Core core = Core::Classic;
+
+    BlockEngine blockEngine;
+
+    // Ejecutan hasta n instrucciones con el núcleo seleccionado. Paran antes
+    // si una escritura toca la dirección vigilada de la memoria (ram->iWatchAddr),
+    // después de un EBREAK o de un acceso fuera de la memoria, o en una
+    // instrucción no válida. Devuelven el número de instrucciones ejecutadas
+    uint32_t runInstructions(uint32_t n);
+    uint32_t runThreaded(uint32_t n);
+
+    // Nivel de las estadísticas que se recogen (ver stats.h). La interfaz
+    // las quiere completas; en las campañas no hacen falta
+    StatsLevel stats = StatsLevel::PerOpcode;
+
+    template <class Stats> void step();
+    template <class Stats> uint32_t runClassic(uint32_t n);
+    template <class Stats> uint32_t runThreadedWith(uint32_t n);
+
+    // Ejecuta hasta budget instrucciones y devuelve el motivo por el que ha parado
+    StopReason run(uint32_t budget, const StopCondition &stop);
+
+    // Después de ejecutar: convierte el acceso fuera de la memoria apuntado en
+    // ram->fault en excepción y, si hay una, deja el PC en la instrucción que
+    // la ha provocado. Devuelve si hay excepción
+    bool takeTrap();
+
     // INSTRUCTIONS
     // R format
     int ADD(); int SUB(); int XOR(); int OR(); int AND();
@@ -70,7 +166,11 @@ public:
 
 
     // Para los ciclos
-    uint64_t ciclosTotales[40], ciclosTipo[6];
+    uint64_t ciclosTotales[Operation::NOP + 1], ciclosTipo[6];
+    std::vector<uint64_t> ciclosPc;     // Por cada palabra de la ROM, solo con StatsLevel::PerPc
+
+    // Deja ciclosPc del tamaño de la ROM si hace falta
+    void prepareStats();
 };
 
 #endif // CPU_H
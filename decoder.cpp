@@ -1,14 +1,19 @@
 /*
-    ESTE ARCHIVO CONTIENE TODAS LAS FUNCIONES QUE SE ENCARGAN DE DECODIFICAR
-    CADA TIPO DE INSTRUCCIÓN.
+    DECODIFICADOR DE INSTRUCCIONES.
 
-    HAY UNA FUNCIÓN PARA CADA TIPO, DE FORMA QUE SEA MÁS LEGIBLE
+    Las tablas y los extractores de operandos se generan en tiempo de
+    compilación a partir de la descripción del juego de instrucciones de
+    isa.h.
 */
 
 #include "decoder.h"
+#include "isa.h"
+#include <array>
+#include <cstddef>
+#include <utility>
 
 // Para el desensamblado
-std::vector<std::string> mnemonics = {
+const char *const mnemonics[] = {
     // Formato R
     "ADD", "SUB", "XOR", "OR", "AND", "SLL", "SRL", "SRA", "SLT", "SLTU",
 
@@ -36,337 +41,180 @@ std::vector<std::string> mnemonics = {
     "NOP"
 };
 
-Decoded decode_R(uint32_t ir) {
-
-    // Esta es la estructura de este tipo de instrucciones:
-    //
-    //      funct7 | rs2 | rs1 | funct3 | rd | opcode
-    //
-    // Por lo que se mueven los bits para sacar cada uno de los
-    // datos.
-
-    uint32_t rd = (ir >> 7) & 0x1F;
-    uint8_t funct3 = (ir >> 12) & 0x7;
-    uint32_t rs1 = (ir >> 15) & 0x1F;
-    uint32_t rs2 = (ir >> 20) & 0x1F;
-    uint32_t funct7 = (ir >> 25) & 0x7F;
-    int nOperation = -1;
-
-    // Ver qué operación hay que hacer
-    if (funct7 == 0x00) {
-        switch (funct3)
-        {
-        case 0x0:
-            nOperation = ADD;
-            break;
-        case 0x4:
-            nOperation = XOR;
-            break;
-        case 0x6:
-            nOperation = OR;
-            break;
-        case 0x7:
-            nOperation = AND;
-            break;
-        case 0x1:
-            nOperation = SLL;
-            break;
-        case 0x5:
-            nOperation = SRL;
-            break;
-        case 0x2:
-            nOperation = SLT;
-            break;
-        case 0x3:
-            nOperation = SLTU;
-            break;
-        default:
-            nOperation = NOP;
-            break;
-        }
-    }
-    else {	// Solo SRA y SUB
-        switch (funct3)
-        {
-        case 0x0:
-            nOperation = SUB;
-            break;
-        case 0x5:
-            nOperation = SRA;
-            break;
-        default:
-            nOperation = NOP;
-            break;
-        }
-    }
+//===================================================
+//          DECODIFICADOR GENERADO CON isa.h
+//===================================================
 
-    // Devuelve la operación y los registros
-    Decoded dec;
-    dec.mnemonic = mnemonics[nOperation];
-    dec.op = nOperation;
-    dec.registers = new uint32_t[3]{ rd, rs1, rs2 };
-    return dec;
-}
+// La clave de la tabla es el opcode y funct3 (10 bits). Cada clave guarda
+// las entradas de la ISA que pueden encajar con ella, en el orden de
+// isa.h, y se usa la primera cuya máscara encaja con la instrucción entera.
+// Casi todas las claves tienen una sola; las que también miran funct7 o el
+// inmediato (ADD y SUB, SRLI y SRAI, ECALL y EBREAK...) tienen alguna más
+const size_t DECODE_KEYS = 1 << 10;
 
+// Una entrada encaja como mucho con las 8 claves de su opcode
+const size_t MAX_CANDIDATES = 8 * ISA_SIZE;
 
+struct DecodeSlot
+{
+    uint16_t first;     // Primera entrada en DecodeTables::candidates
+    uint8_t count;
+};
 
-Decoded decode_I(uint32_t ir, uint8_t op) {
+struct DecodeTables
+{
+    DecodeSlot slots[DECODE_KEYS];
+    uint8_t candidates[MAX_CANDIDATES];     // Índices de ISA
+};
 
-    // Esta es la estructura de este tipo de instrucciones:
-    //
-    //      inm | rs1 | funct3 | rd | opcode
-    //
-    // Por lo que se mueven los bits para sacar cada uno de los
-    // datos.
+constexpr uint32_t decodeKey(uint32_t ir) {
+    return (ir & MASK_OPCODE) | ((ir >> 5) & 0x380);
+}
 
-    uint32_t rd = (ir >> 7) & 0x1F;
-    uint8_t funct3 = (ir >> 12) & 0x7;
-    uint32_t rs1 = (ir >> 15) & 0x1F;
-    int32_t inm = (ir >> 20) & 0xfff;
-    uint32_t funct7 = (ir >> 25) & 0x7F;
-    int nOperation = -1;
+constexpr DecodeTables buildDecodeTables() {
+    DecodeTables tables = {};
+    uint16_t n = 0;
 
+    for (uint32_t key = 0; key < DECODE_KEYS; key++) {
+        // Instrucción con el opcode y funct3 de la clave
+        uint32_t word = (key & MASK_OPCODE) | ((key >> 7) << 12);
 
-    if (inm & 0x800) { // Si el bit más significativo está establecido
-        inm |= 0xFFFFF000; // Extensión del signo
-    }
-    //           1000 0101 1100
-    //                  |
-    //                  |
-    // 1111 1111 1111 1111 1111 1000 0101 1100
-
-    if (op == 0) {
-        switch (funct3)
-        {
-        // Inmediatas
-        case 0x0:
-            nOperation = ADDI;
-
-            break;
-        case 0x4:
-            nOperation = XORI;
-            break;
-        case 0x6:
-            nOperation = ORI;
-            break;
-        case 0x7:
-            nOperation = ANDI;
-            break;
-        case 0x1:
-            nOperation = SLLI;
-            break;
-        case 0x5:
-            if (funct7 == 0)
-                nOperation = SRLI;
-            else
-                nOperation = SRAI;
-            break;
-        case 0x2:
-            nOperation = SLTI;
-            break;
-        case 0x3:
-            nOperation = SLTIU;
-            break;
-        default:
-            nOperation = NOP;
-            break;
-        }
-    }
-    else if (op == 1) {
-        switch (funct3) {
-        case 0x0:
-            nOperation = LB;
-            break;
-        case 0x1:
-            nOperation = LH;
-            break;
-        case 0x2:
-            nOperation = LW;
-            break;
-        case 0x4:
-            nOperation = LBU;
-            break;
-        case 0x5:
-            nOperation = LHU;
-            break;
-        default:
-            nOperation = NOP;
-            break;
+        tables.slots[key].first = n;
+        for (size_t i = 0; i < ISA_SIZE; i++) {
+            if ((word & ISA[i].mask & MASK_FUNCT3) == (ISA[i].match & MASK_FUNCT3))
+                tables.candidates[n++] = static_cast<uint8_t>(i);
         }
-    }
-    else if(op == 2){
-        nOperation = JALR;
-    }
-    else if (op == 3) {
-        if (inm == 0x0)
-            nOperation = ECALL;
-        else
-            nOperation = EBREAK;
-    }else{
-        nOperation = NOP;
+        tables.slots[key].count = static_cast<uint8_t>(n - tables.slots[key].first);
     }
 
-    // Devuelve la operación y los registros
-    Decoded dec;
-    dec.mnemonic = mnemonics[nOperation];
-    dec.op = nOperation;
-    dec.registers = new uint32_t[2]{ rd, rs1 };
-    dec.inmediate = inm;
-    return dec;
+    return tables;
 }
 
-Decoded decode_S(uint32_t ir) {
-
-    // Esta es la estructura de este tipo de instrucciones:
-    //
-    //      inm[11:5] | rs2 | rs1 | funct3 | inm[4:0] | opcode
-    //
-    // Por lo que se mueven los bits para sacar cada uno de los
-    // datos.
-
-    uint32_t inm_1 = (ir >> 7) & 0x1F;
-    uint8_t funct3 = (ir >> 12) & 0x7;
-    uint32_t rs1 = (ir >> 15) & 0x1F;
-    uint32_t rs2 = (ir >> 20) & 0x1F;
-    uint32_t inm_2 = (ir >> 25) & 0x7F;
-    int nOperation = -1;
-
-    int32_t inm = (inm_2 << 5) | inm_1; // desplaza 5 bits a la izquierda el inm_2 y lo une con inm_1
-
-    if ((inm & 0b100000000000) != 0)	// Para el complemento a dos de los negativos
-        inm = inm | 0xFFFFF000;
-
-    if (funct3 == 0x0)
-        nOperation = SB;
-    else if (funct3 == 0x1)
-        nOperation = SH;
-    else
-        nOperation = SW;
-
-    // Devuelve la operación y los registros
-    Decoded dec;
-    dec.mnemonic = mnemonics[nOperation];
-    dec.op = nOperation;
-    dec.registers = new uint32_t[2]{ rs1, rs2 };
-    dec.inmediate = inm;
-    return dec;
+// Cada entrada tiene que mirar el opcode (si no, podría encajar con más
+// de 8 claves) y su valor no puede tener bits fuera de la máscara
+constexpr bool isaFitsTables() {
+    if (ISA_SIZE > 0xFF)
+        return false;
+
+    for (size_t i = 0; i < ISA_SIZE; i++) {
+        if ((ISA[i].mask & MASK_OPCODE) != MASK_OPCODE || (ISA[i].match & ~ISA[i].mask) != 0)
+            return false;
+    }
+
+    return true;
 }
 
-Decoded decode_B(uint32_t ir) {
-
-
-
-    uint32_t inm_1 = (ir >> 7) & 0x1F;
-    uint8_t funct3 = (ir >> 12) & 0x7;
-    uint32_t rs1 = (ir >> 15) & 0x1F;
-    uint32_t rs2 = (ir >> 20) & 0x1F;
-    uint32_t inm_2 = (ir >> 25) & 0x7F;
-
-    int nOperation = -1;
-
-    switch (funct3)
-    {
-    case 0x0:
-        nOperation = BEQ;
-        break;
-    case 0x1:
-        nOperation = BNE;
-        break;
-    case 0x4:
-        nOperation = BLT;
-        break;
-    case 0x5:
-        nOperation = BGE;
-        break;
-    case 0x6:
-        nOperation = BLTU;
-        break;
-    case 0x7:
-        nOperation = BGEU;
-        break;
-    default:
-        nOperation = NOP;
-        break;
+static_assert(isaFitsTables(), "isa.h: una entrada no mira el opcode o su valor no encaja con su máscara");
+
+static constexpr DecodeTables DECODE_TABLES = buildDecodeTables();
+
+// Registros de cada formato
+constexpr uint8_t fieldRd(uint32_t ir)  { return (ir >> 7) & 0x1F; }
+constexpr uint8_t fieldRs1(uint32_t ir) { return (ir >> 15) & 0x1F; }
+constexpr uint8_t fieldRs2(uint32_t ir) { return (ir >> 20) & 0x1F; }
+
+template <uint8_t F> struct Registers;
+
+template <> struct Registers<FORMAT_R> {
+    static void extract(uint32_t ir, Decoded &dec) {
+        dec.rd = fieldRd(ir);
+        dec.rs1 = fieldRs1(ir);
+        dec.rs2 = fieldRs2(ir);
+    }
+};
+
+template <> struct Registers<FORMAT_I> {
+    static void extract(uint32_t ir, Decoded &dec) {
+        dec.rd = fieldRd(ir);
+        dec.rs1 = fieldRs1(ir);
     }
+};
 
-    // inm_1 tiene los bits 4:1|11
-    // inm_2 tiene los bits 12|10:5
-    // Esto con la extensión de signo hecha, es decir,
-    // con el complemento a 2 si es necesario
-
-    // el primer bit será el último del número
-    uint8_t bit11 = inm_1 & 0x01;
-    uint8_t bit12 = inm_2 >> 6;
-    int32_t inmediate = 0;
-    if (bit11 == 1) {
-        inmediate = 0b100000000000;
+template <> struct Registers<FORMAT_S> {
+    static void extract(uint32_t ir, Decoded &dec) {
+        dec.rs1 = fieldRs1(ir);
+        dec.rs2 = fieldRs2(ir);
     }
+};
 
-    inmediate = inmediate | (inm_1 & 0b11110); // 11011 -> 1101 0
-    inmediate = inmediate | ((inm_2 << 5) & 0b011111111111); // 1001011    -> 1001 0110 0000
+template <> struct Registers<FORMAT_B> : Registers<FORMAT_S> {};
 
-    if (bit12 == 1) {
-        // 1111 1111 1111 1111 1111 0000 0000 0000
-        inmediate = inmediate | 0xFFFFF000;
+template <> struct Registers<FORMAT_U> {
+    static void extract(uint32_t ir, Decoded &dec) {
+        dec.rd = fieldRd(ir);
     }
+};
 
-    // Devuelve la operación y los registros
-    Decoded dec;
-    dec.mnemonic = mnemonics[nOperation];
-    dec.op = nOperation;
-    dec.registers = new uint32_t[2]{ rs1, rs2 };
-    dec.inmediate = inmediate;
-    return dec;
-}
+template <> struct Registers<FORMAT_J> : Registers<FORMAT_U> {};
+
+// Inmediato de cada ImmLayout. El bit de signo (31) se extiende con
+// desplazamientos aritméticos
+constexpr int32_t signBits(uint32_t ir, int shift) { return static_cast<int32_t>(ir & 0x80000000) >> shift; }
+
+template <uint8_t L> struct Immediate;
 
-Decoded decode_U(uint32_t ir, uint8_t op) {
-    uint32_t rd = (ir >> 7) & 0x1F;
-    int32_t inm = (ir >> 12);
-    int nOperation = -1;
+template <> struct Immediate<IMM_NONE> {
+    static constexpr int32_t extract(uint32_t) { return 0; }
+};
+
+template <> struct Immediate<IMM_I> {
+    static constexpr int32_t extract(uint32_t ir) { return static_cast<int32_t>(ir) >> 20; }
+};
 
-    Decoded dec;
+template <> struct Immediate<IMM_S> {
+    static constexpr int32_t extract(uint32_t ir) {
+        return signBits(ir, 20) | ((ir >> 20) & 0x7E0) | ((ir >> 7) & 0x1F);
+    }
+};
 
-    if (op == 0){
-        nOperation = LUI;
-    }else{
-        nOperation = AUIPC;
+template <> struct Immediate<IMM_B> {
+    static constexpr int32_t extract(uint32_t ir) {
+        return signBits(ir, 19) | ((ir << 4) & 0x800) | ((ir >> 20) & 0x7E0) | ((ir >> 7) & 0x1E);
     }
+};
 
-    dec.mnemonic = mnemonics[nOperation];
-    dec.op = nOperation;
-    dec.inmediate = inm;
-    dec.registers = new uint32_t[1] {rd};
-    return dec;
-}
+template <> struct Immediate<IMM_U> {
+    static constexpr int32_t extract(uint32_t ir) { return ir >> 12; }
+};
 
-Decoded decode_J(uint32_t ir) {
-    uint32_t rd = (ir >> 7) & 0x1F;
-    int32_t inm = (ir >> 12);
+template <> struct Immediate<IMM_J> {
+    static constexpr int32_t extract(uint32_t ir) {
+        return signBits(ir, 11) | (ir & 0xFF000) | ((ir >> 9) & 0x800) | ((ir >> 20) & 0x7FE);
+    }
+};
 
-    // Bit 20 en la posición 19 (empezando en 0)
-    uint32_t bit20 = inm & 0b10000000000000000000;
+// Decodificador de la entrada I de la ISA, con su formato y su inmediato fijos
+template <size_t I>
+void decodeEntry(uint32_t ir, Decoded &dec) {
+    dec.op = ISA[I].op;
+    dec.tipo = ISA[I].format;
+    Registers<ISA[I].format>::extract(ir, dec);
+    dec.inmediate = Immediate<ISA[I].imm>::extract(ir);
+}
 
-    // Bit 11 en la posición 8 (empezando en 0)
-    uint16_t bit11 = inm & 0b100000000;
+typedef void (*EntryDecoder)(uint32_t ir, Decoded &dec);
 
-    uint32_t inm_2 = (inm & 0xFF) << 12;
-    uint16_t inm_1 = (inm >> 8) & 0x7FE; // 0111 1111 1110
+template <size_t... I>
+constexpr std::array<EntryDecoder, sizeof...(I)> makeEntryDecoders(std::index_sequence<I...>) {
+    return {{ decodeEntry<I>... }};
+}
 
-    int32_t inm_fin = inm_2 | inm_1;
-    if (bit11 != 0)	// Si el bit 11 está en 1, lo añade
-        inm_fin = inm_fin | 0b100000000000;
+// Indexado igual que ISA
+static constexpr std::array<EntryDecoder, ISA_SIZE> ENTRY_DECODERS = makeEntryDecoders(std::make_index_sequence<ISA_SIZE>());
 
-    // Si el bit 20 está en 1, significa que es
-    // un número negativo, por lo que hay que rellenar todo
-    // lo demás con 1.
-    if (bit20 != 0)
-        inm_fin = inm_fin | 0xfff00000;
+Decoded decodeInstruction(uint32_t ir) {
+    Decoded dec = {};
+    DecodeSlot slot = DECODE_TABLES.slots[decodeKey(ir)];
 
+    for (uint32_t k = 0; k < slot.count; k++) {
+        uint8_t i = DECODE_TABLES.candidates[slot.first + k];
+        if ((ir & ISA[i].mask) == ISA[i].match) {
+            ENTRY_DECODERS[i](ir, dec);
+            return dec;
+        }
+    }
 
-    Decoded dec;
-    dec.op = JAL;
-    dec.mnemonic = mnemonics[JAL];
-    dec.inmediate = inm_fin;
-    dec.registers = new uint32_t[1]{ rd };
+    dec.op = Operation::NOP;
+    dec.tipo = FORMAT_UNKNOWN;
     return dec;
 }
@@ -38,25 +38,32 @@ enum Operation
     NOP
 };
 
+// Formato de la instrucción. Es también el índice de CPU::ciclosTipo
+enum Format : uint8_t
+{
+    FORMAT_R, FORMAT_I, FORMAT_S, FORMAT_B, FORMAT_U, FORMAT_J,
+    FORMAT_UNKNOWN = 0xFF   // El opcode no existe
+};
+
+// Instrucción decodificada. No reserva memoria, así que copiarla no cuesta
+// nada. El mnemónico se busca en mnemonics solo al desensamblar
 struct Decoded
 {
-    std::string mnemonic;
-    int op;
-    uint32_t* registers;
+    uint8_t op;             // Operation
+    uint8_t rd, rs1, rs2;   // Los que no usa el formato quedan a 0
     int32_t inmediate;
+    uint8_t tipo;           // Format
 };
 
-Decoded decode_R(uint32_t ir);
-
-Decoded decode_I(uint32_t ir, uint8_t op);
-
-Decoded decode_S(uint32_t ir);
-
-Decoded decode_B(uint32_t ir);
-
-Decoded decode_U(uint32_t ir, uint8_t op);
+// Nombres de las operaciones, indexados por Operation
+extern const char *const mnemonics[];
 
-Decoded decode_J(uint32_t ir);
+// Decodifica una instrucción con las tablas generadas a partir de isa.h.
+// Lo que no encaja con ninguna entrada es NOP con FORMAT_UNKNOWN
+Decoded decodeInstruction(uint32_t ir);
 
+// FENCE (opcode MISC-MEM, funct3 0) se decodifica como NOP. Con un solo
+// hilo y sin cachés de datos no hay nada que ordenar, así que no hace nada
+inline bool isFence(uint32_t ir) { return (ir & 0x0000707F) == 0x0000000F; }
 
 #endif // DECODER_H
@@ -6,4 +6,14 @@
 uint16_t FlipHalf(uint16_t half);
 uint32_t FlipWord(uint32_t word);
 
+// Convierten entre el orden del host y little-endian (el de la memoria del
+// emulador). En un host little-endian no hacen nada
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+inline uint16_t LittleHalf(uint16_t half) { return FlipHalf(half); }
+inline uint32_t LittleWord(uint32_t word) { return FlipWord(word); }
+#else
+inline uint16_t LittleHalf(uint16_t half) { return half; }
+inline uint32_t LittleWord(uint32_t word) { return word; }
+#endif
+
 #endif // ENDIAN_H
@@ -0,0 +1,28 @@
+#include "eventscheduler.h"
+#include "cpu.h"
+#include <algorithm>
+
+// Orden del montículo: el primero es el menor
+static bool later(const Event &a, const Event &b){
+    if (a.cycle != b.cycle)
+        return a.cycle > b.cycle;
+    if (a.type != b.type)
+        return a.type > b.type;
+    return a.data > b.data;
+}
+
+void EventScheduler::schedule(uint32_t cycle, EventType type, uint32_t data){
+    heap.push_back({ cycle, type, data });
+    std::push_heap(heap.begin(), heap.end(), later);
+}
+
+uint32_t EventScheduler::nextCycle() const{
+    return heap.empty() ? StopCondition::NONE : heap.front().cycle;
+}
+
+Event EventScheduler::pop(){
+    std::pop_heap(heap.begin(), heap.end(), later);
+    Event event = heap.back();
+    heap.pop_back();
+    return event;
+}
@@ -0,0 +1,50 @@
+#ifndef EVENTSCHEDULER_H
+#define EVENTSCHEDULER_H
+
+/*
+    Eventos programados para un ciclo concreto de la ejecución: inyecciones,
+    comprobaciones del hash del estado, el límite de una ejecución...
+
+    Se guardan en un montículo ordenado por ciclo. Computer::run() ejecuta
+    sin interrupciones hasta el ciclo del primero y para con
+    StopReason::Event, y quien lo ha programado lo saca con pop() y hace lo
+    que toque. Así el bucle de ejecución no comprueba nada por instrucción,
+    y una misma ejecución puede tener varias inyecciones.
+
+    Los eventos del mismo ciclo salen por orden de tipo: primero las
+    inyecciones y después las comprobaciones.
+*/
+#include <cstdint>
+#include <vector>
+
+enum class EventType : uint8_t {
+    Injection,      // data: índice de la inyección en la campaña
+    HashCheck,      // Comparar con el hash de la ejecución de referencia
+    Limit           // Fin de la ejecución
+};
+
+struct Event {
+    uint32_t cycle;
+    EventType type;
+    uint32_t data;
+};
+
+class EventScheduler {
+public:
+    void schedule(uint32_t cycle, EventType type, uint32_t data = 0);
+
+    bool empty() const { return heap.empty(); }
+
+    // Ciclo del siguiente evento, o StopCondition::NONE si no hay ninguno
+    uint32_t nextCycle() const;
+
+    // Saca el siguiente evento. No puede estar vacío
+    Event pop();
+
+    void clear() { heap.clear(); }
+
+private:
+    std::vector<Event> heap;
+};
+
+#endif // EVENTSCHEDULER_H
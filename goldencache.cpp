@@ -0,0 +1,152 @@
+#include "goldencache.h"
+#include "atomicfile.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static const char *const MAGIC = "kronos-golden";
+static const uint32_t BURST = 1000000;      // Instrucciones por ráfaga de run()
+
+// FNV-1a de 64 bits
+static void hashBytes(uint64_t &hash, const void *data, size_t size){
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+}
+
+static void hashWord(uint64_t &hash, uint32_t value){
+    uint8_t bytes[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+    hashBytes(hash, bytes, sizeof(bytes));
+}
+
+uint64_t goldenKey(const Computer &model, const std::string &program, uint32_t resultAddr){
+    std::ifstream file(program, std::ios::binary);
+    if (!file.is_open())
+        return 0;
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+    uint64_t size = 0;
+
+    char buffer[64 * 1024];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        hashBytes(hash, buffer, file.gcount());
+        size += file.gcount();
+    }
+
+    hashWord(hash, static_cast<uint32_t>(size));
+    hashWord(hash, GOLDEN_VERSION);
+    hashWord(hash, model.ram.iMemorySize);
+    hashWord(hash, model.ram.iRomStartAddr);
+    hashWord(hash, model.stop.finishAddr);
+    hashWord(hash, resultAddr);
+
+    return hash == 0 ? 1 : hash;
+}
+
+int runGolden(const Computer &model, const std::string &program, uint32_t resultAddr,
+              uint32_t limit, GoldenRun &golden){
+    Computer computer(model.ram.iMemorySize);
+    computer.ram.iRomStartAddr = model.ram.iRomStartAddr;
+    computer.cpu.core = model.cpu.core;
+    computer.cpu.stats = StatsLevel::None;
+    computer.cpu.history.setDepth(0);
+    computer.stop.finishAddr = model.stop.finishAddr;
+
+    computer.reset();
+    if (computer.LoadProgram(program) != 0)
+        return 1;
+
+    StopReason reason = StopReason::Budget;
+    while (reason == StopReason::Budget && computer.cpu.cycles < limit)
+        reason = computer.run(std::min(BURST, limit - computer.cpu.cycles));
+
+    if (reason == StopReason::Trap) {
+        std::cerr << "La ejecución de referencia para con una excepción: " << trapName(computer.cpu.trap) << std::endl;
+        return 1;
+    }
+    if (reason != StopReason::Finished) {
+        std::cerr << "La ejecución de referencia no termina" << std::endl;
+        return 1;
+    }
+
+    golden.instructions = computer.cpu.cycles;
+    golden.result = computer.ram.readByte(resultAddr);
+    return 0;
+}
+
+static std::string cacheFile(const std::string &cacheDir, uint64_t key){
+    char name[64];
+    std::snprintf(name, sizeof(name), "golden-%016llx.txt", static_cast<unsigned long long>(key));
+    return cacheDir + "/" + name;
+}
+
+static int readCache(const std::string &filename, uint64_t key, GoldenRun &golden){
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return 1;
+
+    std::string magic;
+    uint32_t version;
+    uint64_t fileKey;
+    file >> magic >> version >> std::hex >> fileKey >> std::dec >> golden.instructions >> golden.result;
+
+    if (!file || magic != MAGIC || version != GOLDEN_VERSION || fileKey != key) {
+        std::cerr << "Caché de la ejecución de referencia no válida: " << filename << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int writeCache(const std::string &cacheDir, const std::string &filename, uint64_t key, const GoldenRun &golden){
+    std::error_code error;
+    std::filesystem::create_directories(cacheDir, error);
+
+    // Se escribe aparte y se renombra, por si hay otro proceso leyéndolo o
+    // guardando la misma ejecución
+    std::string temp = tempFileName(filename);
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Error al crear el archivo: " << temp << std::endl;
+            return 1;
+        }
+
+        file << MAGIC << " " << GOLDEN_VERSION << " " << std::hex << key << std::dec << " "
+             << golden.instructions << " " << golden.result << "\n";
+
+        if (!file.good()) {
+            file.close();
+            std::remove(temp.c_str());
+            std::cerr << "Error al escribir el archivo: " << temp << std::endl;
+            return 1;
+        }
+    }
+
+    if (replaceFile(temp, filename) != 0) {
+        std::cerr << "Error al renombrar " << temp << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int findGolden(const Computer &model, const std::string &program, uint32_t resultAddr,
+               uint32_t limit, const std::string &cacheDir, GoldenRun &golden){
+    uint64_t key = cacheDir.empty() ? 0 : goldenKey(model, program, resultAddr);
+    if (key == 0)
+        return runGolden(model, program, resultAddr, limit, golden);
+
+    std::string filename = cacheFile(cacheDir, key);
+    if (readCache(filename, key, golden) == 0 && golden.instructions <= limit)
+        return 0;
+
+    if (runGolden(model, program, resultAddr, limit, golden) != 0)
+        return 1;
+
+    // Si no se puede guardar, la próxima vez se vuelve a ejecutar
+    writeCache(cacheDir, filename, key, golden);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef GOLDENCACHE_H
+#define GOLDENCACHE_H
+
+/*
+    Caché en disco de las ejecuciones de referencia (golden run).
+
+    Las campañas sin expectedInstructions necesitan ejecutar el programa
+    entero antes de empezar. Como el resultado solo depende del binario y
+    de la configuración de la memoria, se guarda en cacheDir con el nombre
+    golden-<clave>.txt, y la clave es un hash del contenido del programa,
+    el tamaño de la RAM, la ROM y las direcciones de fin y del resultado.
+    Si el binario cambia, cambia la clave y se vuelve a ejecutar. La clave
+    también incluye GOLDEN_VERSION, que hay que subir cada vez que cambie lo
+    que hace una ejecución (instrucciones nuevas, excepciones...) para que
+    no se usen resultados de una versión anterior del emulador.
+
+    Cada archivo es una línea de texto:
+
+        kronos-golden versión clave instrucciones resultado
+
+    (la clave en hexadecimal). Los puntos de control no se guardan: los
+    graba el ejecutor de campañas en su propia pasada.
+*/
+#include <cstdint>
+#include <string>
+#include "computer.h"
+
+// Versión de la semántica de ejecución que tiene en cuenta la caché
+constexpr uint32_t GOLDEN_VERSION = 2;
+
+struct GoldenRun {
+    uint32_t instructions = 0;
+    int32_t result = 0;             // Byte del resultado
+};
+
+// Clave de program con la configuración de model. Devuelve 0 si no se
+// puede leer el programa
+uint64_t goldenKey(const Computer &model, const std::string &program, uint32_t resultAddr);
+
+// Ejecuta program en un ordenador aparte configurado como model. Devuelve 1
+// si no se puede cargar o no termina antes de limit instrucciones
+int runGolden(const Computer &model, const std::string &program, uint32_t resultAddr,
+              uint32_t limit, GoldenRun &golden);
+
+// Lo mismo, pero si cacheDir no está vacío busca antes el resultado en la
+// caché, y si no está lo guarda allí
+int findGolden(const Computer &model, const std::string &program, uint32_t resultAddr,
+               uint32_t limit, const std::string &cacheDir, GoldenRun &golden);
+
+#endif // GOLDENCACHE_H
@@ -0,0 +1,21 @@
+#include "history.h"
+
+// Cambia el tamaño del historial. Se pierde lo que hubiera guardado
+void InstructionHistory::setDepth(size_t depth){
+    buffer.assign(depth < MAX_DEPTH ? depth : MAX_DEPTH, HistoryEntry{});
+    clear();
+}
+
+void InstructionHistory::clear(){
+    head = 0;
+    count = 0;
+    total = 0;
+}
+
+const HistoryEntry& InstructionHistory::at(size_t i) const {
+    size_t first = (count < buffer.size()) ? 0 : head;  // Si está lleno, la más antigua es la siguiente a escribir
+    size_t index = first + i;
+    if (index >= buffer.size())
+        index -= buffer.size();
+    return buffer[index];
+}
@@ -0,0 +1,60 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/*
+    Historial de las últimas instrucciones ejecutadas. Solo guarda el PC y
+    el IR de cada una en un buffer circular de tamaño fijo; el texto del
+    desensamblado se genera a partir de aquí cuando alguien lo pide.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct HistoryEntry
+{
+    uint32_t pc;
+    uint32_t ir;
+};
+
+class InstructionHistory {
+public:
+    // Límite de setDepth(): 16M instrucciones, 128 MB
+    static const size_t MAX_DEPTH = size_t(1) << 24;
+
+    // Número máximo de instrucciones guardadas (como mucho MAX_DEPTH). Con
+    // 0 no se guarda nada
+    void setDepth(size_t depth);
+    size_t depth() const { return buffer.size(); }
+
+    void clear();
+
+    inline void push(uint32_t pc, uint32_t ir){
+        if (buffer.empty())
+            return;
+
+        buffer[head] = { pc, ir };
+        if (++head == buffer.size())
+            head = 0;
+        if (count < buffer.size())
+            count++;
+        total++;
+    }
+
+    // Instrucciones guardadas ahora mismo (como mucho depth())
+    size_t size() const { return count; }
+
+    // Instrucciones guardadas desde el último clear(), incluidas las que ya
+    // se han sobrescrito. Sirve para saber cuáles son nuevas
+    uint64_t pushed() const { return total; }
+
+    // Entrada i, empezando por la más antigua que sigue guardada
+    const HistoryEntry& at(size_t i) const;
+
+private:
+    std::vector<HistoryEntry> buffer;
+    size_t head = 0;    // Siguiente posición a escribir
+    size_t count = 0;
+    uint64_t total = 0;
+};
+
+#endif // HISTORY_H
@@ -0,0 +1,33 @@
+#include "icache.h"
+
+// Establece la región de la ROM que se va a cachear
+void InstructionCache::setRegion(uint32_t start, uint32_t size){
+    iStart = start;
+    iSize = (size + 3) & ~0x3u;  // Se redondea a palabras completas
+
+    entries.assign(iSize / 4, PredecodedInst{});
+    generation++;
+}
+
+// Invalida todas las entradas sin cambiar la región
+void InstructionCache::clear(){
+    for (auto &entry : entries) {
+        entry.valid = 0;
+    }
+    generation++;
+}
+
+void InstructionCache::invalidateRange(uint32_t addr, uint32_t len){
+    bool bChanged = false;
+
+    for (uint32_t offset = 0; offset < len; offset += 4) {
+        PredecodedInst *entry = lookup((addr & ~0x3u) + offset);
+        if (entry != nullptr && entry->valid) {
+            entry->valid = 0;
+            bChanged = true;
+        }
+    }
+
+    if (bChanged)
+        generation++;
+}
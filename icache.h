@@ -0,0 +1,67 @@
+#ifndef ICACHE_H
+#define ICACHE_H
+
+/*
+    Caché de instrucciones predecodificadas. Guarda una entrada por cada
+    palabra de la zona ROM (donde se carga el programa), de forma que cada
+    instrucción solo se lee de memoria y se decodifica la primera vez que
+    se ejecuta.
+*/
+#include <cstdint>
+#include <vector>
+
+// Instrucción ya decodificada. Es un POD para que copiarla no cueste nada
+struct PredecodedInst
+{
+    uint32_t ir;            // Instrucción original (para el desensamblado)
+    int32_t inmediate;
+    uint8_t op;             // Operation
+    uint8_t tipo;           // Formato (índice de ciclosTipo), 0xFF si el opcode no existe
+    uint8_t rd, rs1, rs2;   // Igual que en Decoded
+    uint8_t valid;
+};
+
+class InstructionCache {
+public:
+    uint32_t iStart = 0;    // Dirección de inicio de la región cacheada
+    uint32_t iSize = 0;     // Tamaño en bytes de la región
+
+    std::vector<PredecodedInst> entries;
+
+    // Se incrementa cada vez que se invalida código ya decodificado, para que
+    // quien guarde traducciones de la ROM (el motor de bloques) sepa que debe descartarlas
+    uint32_t generation = 0;
+
+    // Establece la región [start, start + size) y vacía la caché
+    void setRegion(uint32_t start, uint32_t size);
+    void clear();
+
+    // Invalida todas las entradas de [addr, addr + len) que estén en la región
+    void invalidateRange(uint32_t addr, uint32_t len);
+
+    // Devuelve la entrada de la dirección pc, o nullptr si no está en la región
+    inline PredecodedInst* lookup(uint32_t pc){
+        uint32_t offset = pc - iStart;
+        if (offset >= iSize || (offset & 0x3) != 0)
+            return nullptr;
+        return &entries[offset >> 2];
+    }
+
+    // Invalida las entradas que pisa una escritura de len bytes (1, 2 o 4) en addr.
+    // Como mucho puede tocar dos palabras, la del primer byte y la del último
+    inline void invalidate(uint32_t addr, uint32_t len){
+        uint32_t first = addr - iStart;
+        uint32_t last = first + len - 1;
+
+        if (first < iSize && entries[first >> 2].valid) {
+            entries[first >> 2].valid = 0;
+            generation++;
+        }
+        if (last < iSize && entries[last >> 2].valid) {
+            entries[last >> 2].valid = 0;
+            generation++;
+        }
+    }
+};
+
+#endif // ICACHE_H
@@ -0,0 +1,61 @@
+#ifndef INJECTIONS_H
+#define INJECTIONS_H
+
+/*
+    Inyecciones de una campaña. Cada una es un registro de 8 bytes, el mismo
+    que en el formato binario de campañas (campaignfile.h), así que una
+    campaña binaria se recorre directamente sobre el archivo mapeado en
+    memoria, sin copiarla.
+
+    InjectionList es solo una vista: las inyecciones pueden ser de un vector
+    propio (las de un JSON) o del archivo mapeado, y copiar la lista o
+    coger un trozo (slice) no copia las inyecciones.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct Injection {
+    uint32_t cycle;         // Instrucción antes de la que se invierte el bit
+    uint8_t reg;            // Registro (0 - 31)
+    uint8_t bit;            // Bit del registro (0 - 31)
+    uint16_t reserved;      // 0
+};
+
+static_assert(sizeof(Injection) == 8, "Injection tiene que ocupar 8 bytes, como en el archivo");
+
+class InjectionList {
+public:
+    InjectionList() = default;
+
+    // Se queda con las inyecciones de owned
+    InjectionList(std::vector<Injection> owned){
+        auto vector = std::make_shared<std::vector<Injection>>(std::move(owned));
+        pData = vector->data();
+        iCount = vector->size();
+        storage = std::move(vector);
+    }
+
+    // Vista sobre count inyecciones en data, que siguen siendo válidas
+    // mientras viva storage
+    InjectionList(std::shared_ptr<const void> storage, const Injection *data, size_t count)
+        : storage(std::move(storage)), pData(data), iCount(count) {}
+
+    size_t size() const { return iCount; }
+    bool empty() const { return iCount == 0; }
+
+    const Injection& operator[](size_t i) const { return pData[i]; }
+    const Injection* begin() const { return pData; }
+    const Injection* end() const { return pData + iCount; }
+
+    // Inyecciones [first, last), compartiendo las de esta lista
+    InjectionList slice(size_t first, size_t last) const { return InjectionList(storage, pData + first, last - first); }
+
+private:
+    std::shared_ptr<const void> storage;
+    const Injection *pData = nullptr;
+    size_t iCount = 0;
+};
+
+#endif // INJECTIONS_H
@@ -0,0 +1,118 @@
+#ifndef ISA_H
+#define ISA_H
+
+/*
+    Descripción del juego de instrucciones RV32I. Cada instrucción se
+    reconoce por una máscara y un valor (como en la especificación), y
+    lleva su formato (los registros que usa), cómo está repartido su
+    inmediato y la función del núcleo clásico que la ejecuta. A partir de
+    esta tabla se generan en tiempo de compilación las tablas y los
+    extractores de operandos del decodificador (decoder.cpp) y el
+    vFunctionMap de la CPU.
+
+    El orden importa: se usa la primera entrada que encaja, así que las
+    entradas con máscaras más amplias (los NOP de cada opcode) van después
+    de las más concretas.
+
+    Para añadir una extensión basta con añadir su Operation, su función y
+    sus entradas. La máscara puede mirar cualquier bit (funct7, el
+    inmediato o la instrucción entera); la única condición, que se
+    comprueba al compilar, es que incluya el opcode.
+*/
+#include <cstdint>
+#include "cpu.h"
+#include "decoder.h"
+
+// Cómo está repartido el inmediato en la instrucción
+enum ImmLayout : uint8_t
+{
+    IMM_NONE,   // No tiene
+    IMM_I,      // [31:20], con signo
+    IMM_S,      // [31:25] y [11:7], con signo
+    IMM_B,      // [31], [7], [30:25] y [11:8], con signo y múltiplo de 2
+    IMM_U,      // [31:12], sin desplazar
+    IMM_J       // [31], [19:12], [20] y [30:21], con signo y múltiplo de 2
+};
+
+struct IsaEntry
+{
+    uint32_t mask;
+    uint32_t match;
+    uint8_t op;             // Operation
+    uint8_t format;         // Format
+    uint8_t imm;            // ImmLayout
+    int (CPU::*handler)();  // Función del núcleo clásico
+};
+
+// Máscaras de los campos que identifican la instrucción
+constexpr uint32_t MASK_OPCODE = 0x0000007F;
+constexpr uint32_t MASK_FUNCT3 = 0x0000707F;   // opcode + funct3
+constexpr uint32_t MASK_FUNCT7 = 0xFE00707F;   // opcode + funct3 + funct7
+constexpr uint32_t MASK_ALL    = 0xFFFFFFFF;   // La instrucción entera
+
+constexpr IsaEntry ISA[] = {
+    // Formato R. Solo existen funct7 0 y, en SUB y SRA, 0x20
+    { MASK_FUNCT7, 0x00000033, ADD,    FORMAT_R, IMM_NONE, &CPU::ADD },
+    { MASK_FUNCT7, 0x00001033, SLL,    FORMAT_R, IMM_NONE, &CPU::SLL },
+    { MASK_FUNCT7, 0x00002033, SLT,    FORMAT_R, IMM_NONE, &CPU::SLT },
+    { MASK_FUNCT7, 0x00003033, SLTU,   FORMAT_R, IMM_NONE, &CPU::SLTU },
+    { MASK_FUNCT7, 0x00004033, XOR,    FORMAT_R, IMM_NONE, &CPU::XOR },
+    { MASK_FUNCT7, 0x00005033, SRL,    FORMAT_R, IMM_NONE, &CPU::SRL },
+    { MASK_FUNCT7, 0x00006033, OR,     FORMAT_R, IMM_NONE, &CPU::OR },
+    { MASK_FUNCT7, 0x00007033, AND,    FORMAT_R, IMM_NONE, &CPU::AND },
+    { MASK_FUNCT7, 0x40000033, SUB,    FORMAT_R, IMM_NONE, &CPU::SUB },
+    { MASK_FUNCT7, 0x40005033, SRA,    FORMAT_R, IMM_NONE, &CPU::SRA },
+    { MASK_OPCODE, 0x00000033, NOP,    FORMAT_R, IMM_NONE, &CPU::NOP },
+
+    // Formato I, aritméticas. En los desplazamientos los 7 bits altos del
+    // inmediato son funct7: 0, o 0x20 en SRAI
+    { MASK_FUNCT3, 0x00000013, ADDI,   FORMAT_I, IMM_I, &CPU::ADDI },
+    { MASK_FUNCT7, 0x00001013, SLLI,   FORMAT_I, IMM_I, &CPU::SLLI },
+    { MASK_FUNCT3, 0x00002013, SLTI,   FORMAT_I, IMM_I, &CPU::SLTI },
+    { MASK_FUNCT3, 0x00003013, SLTIU,  FORMAT_I, IMM_I, &CPU::SLTIU },
+    { MASK_FUNCT3, 0x00004013, XORI,   FORMAT_I, IMM_I, &CPU::XORI },
+    { MASK_FUNCT7, 0x00005013, SRLI,   FORMAT_I, IMM_I, &CPU::SRLI },
+    { MASK_FUNCT7, 0x40005013, SRAI,   FORMAT_I, IMM_I, &CPU::SRAI },
+    { MASK_FUNCT3, 0x00006013, ORI,    FORMAT_I, IMM_I, &CPU::ORI },
+    { MASK_FUNCT3, 0x00007013, ANDI,   FORMAT_I, IMM_I, &CPU::ANDI },
+
+    // Formato I, cargas
+    { MASK_FUNCT3, 0x00000003, LB,     FORMAT_I, IMM_I, &CPU::LB },
+    { MASK_FUNCT3, 0x00001003, LH,     FORMAT_I, IMM_I, &CPU::LH },
+    { MASK_FUNCT3, 0x00002003, LW,     FORMAT_I, IMM_I, &CPU::LW },
+    { MASK_FUNCT3, 0x00004003, LBU,    FORMAT_I, IMM_I, &CPU::LBU },
+    { MASK_FUNCT3, 0x00005003, LHU,    FORMAT_I, IMM_I, &CPU::LHU },
+    { MASK_OPCODE, 0x00000003, NOP,    FORMAT_I, IMM_I, &CPU::NOP },
+
+    { MASK_FUNCT3, 0x00000067, JALR,   FORMAT_I, IMM_I, &CPU::JALR },
+
+    // ECALL y EBREAK son una sola codificación cada una. El resto del
+    // opcode SYSTEM (CSR) no existe en este emulador
+    { MASK_ALL,    0x00000073, ECALL,  FORMAT_I, IMM_I, &CPU::ECALL },
+    { MASK_ALL,    0x00100073, EBREAK, FORMAT_I, IMM_I, &CPU::EBREAK },
+
+    // Formato S
+    { MASK_FUNCT3, 0x00000023, SB,     FORMAT_S, IMM_S, &CPU::SB },
+    { MASK_FUNCT3, 0x00001023, SH,     FORMAT_S, IMM_S, &CPU::SH },
+    { MASK_FUNCT3, 0x00002023, SW,     FORMAT_S, IMM_S, &CPU::SW },
+
+    // Formato B
+    { MASK_FUNCT3, 0x00000063, BEQ,    FORMAT_B, IMM_B, &CPU::BEQ },
+    { MASK_FUNCT3, 0x00001063, BNE,    FORMAT_B, IMM_B, &CPU::BNE },
+    { MASK_FUNCT3, 0x00004063, BLT,    FORMAT_B, IMM_B, &CPU::BLT },
+    { MASK_FUNCT3, 0x00005063, BGE,    FORMAT_B, IMM_B, &CPU::BGE },
+    { MASK_FUNCT3, 0x00006063, BLTU,   FORMAT_B, IMM_B, &CPU::BLTU },
+    { MASK_FUNCT3, 0x00007063, BGEU,   FORMAT_B, IMM_B, &CPU::BGEU },
+    { MASK_OPCODE, 0x00000063, NOP,    FORMAT_B, IMM_B, &CPU::NOP },
+
+    // Formato J
+    { MASK_OPCODE, 0x0000006F, JAL,    FORMAT_J, IMM_J, &CPU::JAL },
+
+    // Formato U
+    { MASK_OPCODE, 0x00000037, LUI,    FORMAT_U, IMM_U, &CPU::LUI },
+    { MASK_OPCODE, 0x00000017, AUIPC,  FORMAT_U, IMM_U, &CPU::AUIPC },
+};
+
+constexpr size_t ISA_SIZE = sizeof(ISA) / sizeof(ISA[0]);
+
+#endif // ISA_H
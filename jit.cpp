@@ -0,0 +1,545 @@
+/*
+    COMPILADOR JIT A x86-64.
+
+    Cada bloque se compila a una función con esta forma:
+
+        push rbx / push r12             ; registros que hay que conservar
+        r12 = ctx, rbx = ctx->registers
+        ... una secuencia por instrucción, con los registros del
+            programa en [rbx + 4 * n] y eax, ecx y edx como temporales ...
+        ctx->executed = instrucciones ejecutadas
+        eax = nuevo PC
+        pop r12 / pop rbx / ret
+
+    Las cargas y escrituras llaman a funciones de este archivo que usan
+    Memory. Devuelven 1 si hay que parar (dirección vigilada, código
+    modificado o acceso fuera de la memoria), y en ese caso el bloque sale
+    justo después.
+*/
+
+#include "jit.h"
+#include "cpu.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <cstring>
+
+//===================================================
+//          FUNCIONES LLAMADAS DESDE EL CÓDIGO
+//===================================================
+
+// Devuelve 1 si el bloque debe parar después del acceso
+static uint32_t jitMustStop(JitContext *ctx) {
+    return (ctx->ram->bWatchHit || ctx->icache->generation != ctx->generation) ? 1 : 0;
+}
+
+// Las cargas dejan el valor en x[rd]
+static uint32_t jitLB(JitContext *ctx, uint32_t addr, uint32_t rd) {
+    ctx->registers[rd] = static_cast<int8_t>(ctx->ram->readByte(addr));
+    return jitMustStop(ctx);
+}
+static uint32_t jitLH(JitContext *ctx, uint32_t addr, uint32_t rd) {
+    ctx->registers[rd] = static_cast<int16_t>(ctx->ram->readHalf(addr));
+    return jitMustStop(ctx);
+}
+static uint32_t jitLW(JitContext *ctx, uint32_t addr, uint32_t rd) {
+    ctx->registers[rd] = ctx->ram->readWord(addr);
+    return jitMustStop(ctx);
+}
+static uint32_t jitLBU(JitContext *ctx, uint32_t addr, uint32_t rd) {
+    ctx->registers[rd] = ctx->ram->readByte(addr) & 0xFF;
+    return jitMustStop(ctx);
+}
+static uint32_t jitLHU(JitContext *ctx, uint32_t addr, uint32_t rd) {
+    ctx->registers[rd] = ctx->ram->readHalf(addr);
+    return jitMustStop(ctx);
+}
+
+static uint32_t jitSB(JitContext *ctx, uint32_t addr, uint32_t value) {
+    ctx->ram->writeByte(addr, value & 0xFF);
+    return jitMustStop(ctx);
+}
+static uint32_t jitSH(JitContext *ctx, uint32_t addr, uint32_t value) {
+    ctx->ram->writeHalf(addr, value & 0xFFFF);
+    return jitMustStop(ctx);
+}
+static uint32_t jitSW(JitContext *ctx, uint32_t addr, uint32_t value) {
+    ctx->ram->writeWord(addr, value);
+    return jitMustStop(ctx);
+}
+
+//===================================================
+//                  MEMORIA EJECUTABLE
+//===================================================
+
+// Reserva memoria, copia el código y la deja como solo lectura y ejecución
+static JitCode allocateCode(const std::vector<uint8_t> &bytes) {
+    JitCode code = { nullptr, bytes.size() };
+
+#ifdef _WIN32
+    void *mem = VirtualAlloc(nullptr, code.size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (mem == nullptr)
+        return code;
+
+    std::memcpy(mem, bytes.data(), code.size);
+
+    DWORD oldProtect;
+    VirtualProtect(mem, code.size, PAGE_EXECUTE_READ, &oldProtect);
+    FlushInstructionCache(GetCurrentProcess(), mem, code.size);
+#else
+    void *mem = mmap(nullptr, code.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return code;
+
+    std::memcpy(mem, bytes.data(), code.size);
+    mprotect(mem, code.size, PROT_READ | PROT_EXEC);
+#endif
+
+    code.memory = mem;
+    return code;
+}
+
+void JitCompiler::release(const JitCode &code) {
+    if (code.memory == nullptr)
+        return;
+
+#ifdef _WIN32
+    VirtualFree(code.memory, 0, MEM_RELEASE);
+#else
+    munmap(code.memory, code.size);
+#endif
+}
+
+//===================================================
+//                  GENERADOR x86-64
+//===================================================
+
+#ifdef KRONOS_JIT_X86_64
+
+namespace {
+
+// Registros de x86 usados (números de codificación)
+enum X86Reg { EAX = 0, ECX = 1, EDX = 2, EBX = 3 };
+
+class Emitter {
+public:
+    std::vector<uint8_t> code;
+
+    void byte(uint8_t b) { code.push_back(b); }
+    void bytes(std::initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+    void imm32(uint32_t v) {
+        for (int i = 0; i < 4; i++)
+            byte((v >> (8 * i)) & 0xFF);
+    }
+    void imm64(uint64_t v) {
+        for (int i = 0; i < 8; i++)
+            byte((v >> (8 * i)) & 0xFF);
+    }
+
+    // Operación "op r32, [rbx + 4 * guest]" (mov, add, sub, cmp...)
+    void regMem(uint8_t opcode, int r, int guest) {
+        bytes({ opcode, static_cast<uint8_t>(0x43 | (r << 3)), static_cast<uint8_t>(4 * guest) });
+    }
+    void loadGuest(int r, int guest)  { regMem(0x8B, r, guest); }
+    void storeGuest(int guest, int r) { regMem(0x89, r, guest); }
+
+    // mov dword [rbx + 4 * guest], imm32
+    void storeGuestImm(int guest, uint32_t value) {
+        bytes({ 0xC7, 0x43, static_cast<uint8_t>(4 * guest) });
+        imm32(value);
+    }
+
+    // Operación "op eax, imm32" con la forma corta de eax
+    void aluEaxImm(uint8_t opcode, uint32_t value) {
+        byte(opcode);
+        imm32(value);
+    }
+
+    void movImm(int r, uint32_t value) {
+        byte(0xB8 + r);
+        imm32(value);
+    }
+
+    // mov reg64, [r12 + disp8]
+    void loadCtx64(int r, uint8_t disp) {
+        bytes({ 0x49, 0x8B, static_cast<uint8_t>(0x44 | (r << 3)), 0x24, disp });
+    }
+
+    // mov dword [r12 + disp8], imm32
+    void storeCtxImm(uint8_t disp, uint32_t value) {
+        bytes({ 0x41, 0xC7, 0x44, 0x24, disp });
+        imm32(value);
+    }
+
+    void callAbsolute(const void *function) {
+        bytes({ 0x48, 0xB8 });  // mov rax, imm64
+        imm64(reinterpret_cast<uint64_t>(function));
+        bytes({ 0xFF, 0xD0 });  // call rax
+    }
+
+    // jnz rel32. Devuelve la posición del desplazamiento para rellenarlo después
+    size_t jnz() {
+        bytes({ 0x0F, 0x85 });
+        size_t pos = code.size();
+        imm32(0);
+        return pos;
+    }
+    size_t jmp() {
+        byte(0xE9);
+        size_t pos = code.size();
+        imm32(0);
+        return pos;
+    }
+    void patch(size_t pos, size_t target) {
+        uint32_t rel = static_cast<uint32_t>(target - (pos + 4));
+        std::memcpy(&code[pos], &rel, 4);
+    }
+};
+
+// Tamaño de la pila reservada: alineación a 16 y, en Windows, el espacio para los argumentos
+#ifdef _WIN32
+const uint8_t STACK_RESERVE = 40;
+#else
+const uint8_t STACK_RESERVE = 8;
+#endif
+
+const uint8_t CTX_REGISTERS  = offsetof(JitContext, registers);
+const uint8_t CTX_EXECUTED   = offsetof(JitContext, executed);
+
+// Prepara los argumentos de una carga: (ctx, x[rs1] + imm, rd)
+void emitLoadArgs(Emitter &e, const BlockOp &op) {
+    e.loadGuest(EAX, op.rs1);
+    e.aluEaxImm(0x05, op.inmediate);        // add eax, imm32
+#ifdef _WIN32
+    e.bytes({ 0x41, 0xB8 });                // mov r8d, rd
+    e.imm32(op.rd);
+    e.bytes({ 0x89, 0xC2 });                // mov edx, eax
+    e.bytes({ 0x4C, 0x89, 0xE1 });          // mov rcx, r12
+#else
+    e.movImm(EDX, op.rd);                   // mov edx, rd
+    e.bytes({ 0x89, 0xC6 });                // mov esi, eax
+    e.bytes({ 0x4C, 0x89, 0xE7 });          // mov rdi, r12
+#endif
+}
+
+// Prepara los argumentos de una escritura: (ctx, x[rs1] + imm, x[rs2])
+void emitStoreArgs(Emitter &e, const BlockOp &op) {
+    e.loadGuest(EAX, op.rs1);
+    e.aluEaxImm(0x05, op.inmediate);        // add eax, imm32
+    e.loadGuest(ECX, op.rs2);
+#ifdef _WIN32
+    e.bytes({ 0x41, 0x89, 0xC8 });          // mov r8d, ecx
+    e.bytes({ 0x89, 0xC2 });                // mov edx, eax
+    e.bytes({ 0x4C, 0x89, 0xE1 });          // mov rcx, r12
+#else
+    e.bytes({ 0x89, 0xCA });                // mov edx, ecx
+    e.bytes({ 0x89, 0xC6 });                // mov esi, eax
+    e.bytes({ 0x4C, 0x89, 0xE7 });          // mov rdi, r12
+#endif
+}
+
+// "xor edx, edx; mov eax, x[rs1]; cmp eax, <b>; setcc dl; mov x[rd], edx"
+void emitSet(Emitter &e, const BlockOp &op, uint8_t setcc, bool bImmediate) {
+    e.bytes({ 0x31, 0xD2 });
+    e.loadGuest(EAX, op.rs1);
+    if (bImmediate)
+        e.aluEaxImm(0x3D, op.inmediate);
+    else
+        e.regMem(0x3B, EAX, op.rs2);
+    e.bytes({ 0x0F, setcc, 0xC2 });
+    e.storeGuest(op.rd, EDX);
+}
+
+// Genera una instrucción del cuerpo. Devuelve false si no se sabe compilar
+bool emitBody(Emitter &e, const BlockOp &op, std::vector<size_t> &stopJumps) {
+    switch (op.op)
+    {
+    // R format
+    case Operation::ADD: e.loadGuest(EAX, op.rs1); e.regMem(0x03, EAX, op.rs2); e.storeGuest(op.rd, EAX); break;
+    case Operation::SUB: e.loadGuest(EAX, op.rs1); e.regMem(0x2B, EAX, op.rs2); e.storeGuest(op.rd, EAX); break;
+    case Operation::XOR: e.loadGuest(EAX, op.rs1); e.regMem(0x33, EAX, op.rs2); e.storeGuest(op.rd, EAX); break;
+    case Operation::OR:  e.loadGuest(EAX, op.rs1); e.regMem(0x0B, EAX, op.rs2); e.storeGuest(op.rd, EAX); break;
+    case Operation::AND: e.loadGuest(EAX, op.rs1); e.regMem(0x23, EAX, op.rs2); e.storeGuest(op.rd, EAX); break;
+
+    // Los desplazamientos de x86 por cl ya usan solo los 5 bits bajos
+    case Operation::SLL:
+    case Operation::SRL:
+    case Operation::SRA:
+        e.loadGuest(EAX, op.rs1);
+        e.loadGuest(ECX, op.rs2);
+        e.bytes({ 0xD3, static_cast<uint8_t>(op.op == Operation::SLL ? 0xE0 : op.op == Operation::SRL ? 0xE8 : 0xF8) });
+        e.storeGuest(op.rd, EAX);
+        break;
+
+    case Operation::SLT:  emitSet(e, op, 0x9C, false); break;   // setl
+    case Operation::SLTU: emitSet(e, op, 0x92, false); break;   // setb
+
+    // I format
+    case Operation::ADDI: e.loadGuest(EAX, op.rs1); e.aluEaxImm(0x05, op.inmediate); e.storeGuest(op.rd, EAX); break;
+    case Operation::XORI: e.loadGuest(EAX, op.rs1); e.aluEaxImm(0x35, op.inmediate); e.storeGuest(op.rd, EAX); break;
+    case Operation::ORI:  e.loadGuest(EAX, op.rs1); e.aluEaxImm(0x0D, op.inmediate); e.storeGuest(op.rd, EAX); break;
+    case Operation::ANDI: e.loadGuest(EAX, op.rs1); e.aluEaxImm(0x25, op.inmediate); e.storeGuest(op.rd, EAX); break;
+
+    case Operation::SLLI:
+    case Operation::SRLI:
+    case Operation::SRAI:
+        e.loadGuest(EAX, op.rs1);
+        e.bytes({ 0xC1, static_cast<uint8_t>(op.op == Operation::SLLI ? 0xE0 : op.op == Operation::SRLI ? 0xE8 : 0xF8),
+                  static_cast<uint8_t>(op.inmediate & 0b11111) });
+        e.storeGuest(op.rd, EAX);
+        break;
+
+    case Operation::SLTI:  emitSet(e, op, 0x9C, true); break;
+    case Operation::SLTIU: emitSet(e, op, 0x92, true); break;
+
+    case Operation::LB:
+    case Operation::LH:
+    case Operation::LW:
+    case Operation::LBU:
+    case Operation::LHU: {
+        const void *function = op.op == Operation::LB ? reinterpret_cast<const void*>(jitLB)
+                             : op.op == Operation::LH ? reinterpret_cast<const void*>(jitLH)
+                             : op.op == Operation::LW ? reinterpret_cast<const void*>(jitLW)
+                             : op.op == Operation::LBU ? reinterpret_cast<const void*>(jitLBU)
+                             : reinterpret_cast<const void*>(jitLHU);
+        emitLoadArgs(e, op);
+        e.callAbsolute(function);
+        e.bytes({ 0x85, 0xC0 });            // test eax, eax
+        stopJumps.push_back(e.jnz());       // Se rellena con la salida de esta instrucción
+        break;
+    }
+
+    case Operation::SB:
+    case Operation::SH:
+    case Operation::SW: {
+        const void *function = op.op == Operation::SB ? reinterpret_cast<const void*>(jitSB)
+                             : op.op == Operation::SH ? reinterpret_cast<const void*>(jitSH)
+                             : reinterpret_cast<const void*>(jitSW);
+        emitStoreArgs(e, op);
+        e.callAbsolute(function);
+        e.bytes({ 0x85, 0xC0 });            // test eax, eax
+        stopJumps.push_back(e.jnz());       // Se rellena con la salida de esta instrucción
+        break;
+    }
+
+    case Operation::ECALL:
+        break;
+
+    // Solo FENCE. Las instrucciones no válidas se quedan en el intérprete,
+    // que apunta la excepción
+    case Operation::NOP:
+        if (op.mayStop)
+            return false;
+        break;
+
+    // LUI y AUIPC ya vienen calculados como constante
+    case Operation::LUI:
+    case Operation::AUIPC:
+        e.storeGuestImm(op.rd, op.inmediate);
+        break;
+
+    // EBREAK no se compila: el bloque se queda en el intérprete, que para después de él
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+// Genera el salto final. Deja el nuevo PC en eax
+void emitExit(Emitter &e, const Block &block, uint32_t exitPc) {
+    const BlockOp &op = block.exitOp;
+
+    if (block.exit == nullptr) {
+        e.movImm(EAX, exitPc);      // Bloque cortado
+        return;
+    }
+
+    switch (op.op)
+    {
+    case Operation::JAL:
+        if (op.rd != 0)
+            e.storeGuestImm(op.rd, exitPc + 4);
+        e.movImm(EAX, exitPc + op.inmediate);
+        return;
+
+    case Operation::JALR:
+        // El destino se calcula antes de escribir rd, que puede ser el mismo que rs1
+        e.loadGuest(EAX, op.rs1);
+        e.aluEaxImm(0x05, op.inmediate);
+        if (op.rd != 0)
+            e.storeGuestImm(op.rd, exitPc + 4);
+        return;
+
+    default: {
+        // Saltos condicionales: eax = no saltar, ecx = destino, cmovcc
+        uint8_t cmov = 0;
+        switch (op.op)
+        {
+        case Operation::BEQ:  cmov = 0x44; break;   // cmove
+        case Operation::BNE:  cmov = 0x45; break;   // cmovne
+        case Operation::BLT:  cmov = 0x4C; break;   // cmovl
+        case Operation::BGE:  cmov = 0x4D; break;   // cmovge
+        case Operation::BLTU: cmov = 0x42; break;   // cmovb
+        case Operation::BGEU: cmov = 0x43; break;   // cmovae
+        }
+
+        e.loadGuest(EDX, op.rs1);
+        e.regMem(0x3B, EDX, op.rs2);                // cmp edx, x[rs2]
+        e.movImm(EAX, exitPc + 4);
+        e.movImm(ECX, exitPc + op.inmediate);
+        e.bytes({ 0x0F, cmov, 0xC1 });              // cmovcc eax, ecx
+        return;
+    }
+    }
+}
+
+} // namespace
+
+#endif // KRONOS_JIT_X86_64
+
+// Compila un bloque. Devuelve memory = nullptr si no se ha podido
+JitCode JitCompiler::compile(const Block &block) {
+#ifdef KRONOS_JIT_X86_64
+    Emitter e;
+
+    // Prólogo
+    e.byte(0x53);                                   // push rbx
+    e.bytes({ 0x41, 0x54 });                        // push r12
+    e.bytes({ 0x48, 0x83, 0xEC, STACK_RESERVE });   // sub rsp, STACK_RESERVE
+#ifdef _WIN32
+    e.bytes({ 0x49, 0x89, 0xCC });                  // mov r12, rcx
+#else
+    e.bytes({ 0x49, 0x89, 0xFC });                  // mov r12, rdi
+#endif
+    e.loadCtx64(EBX, CTX_REGISTERS);                // rbx = ctx->registers
+
+    // Cuerpo. Cada acceso a memoria puede salir antes con su propia salida
+    std::vector<size_t> stopJumps;
+    std::vector<uint32_t> stopCounts;
+
+    for (size_t i = 0; i < block.ops.size(); i++) {
+        size_t before = stopJumps.size();
+
+        if (!emitBody(e, block.ops[i], stopJumps))
+            return { nullptr, 0 };
+
+        if (stopJumps.size() != before)
+            stopCounts.push_back(i + 1);
+    }
+
+    uint32_t exitPc = block.startPc + 4 * block.ops.size();
+    emitExit(e, block, exitPc);
+    e.storeCtxImm(CTX_EXECUTED, block.nInsts);
+
+    // Epílogo
+    size_t epilogue = e.code.size();
+    e.bytes({ 0x48, 0x83, 0xC4, STACK_RESERVE });   // add rsp, STACK_RESERVE
+    e.bytes({ 0x41, 0x5C });                        // pop r12
+    e.byte(0x5B);                                   // pop rbx
+    e.byte(0xC3);                                   // ret
+
+    // Salidas anticipadas después de un acceso a memoria
+    for (size_t k = 0; k < stopJumps.size(); k++) {
+        e.patch(stopJumps[k], e.code.size());
+        e.storeCtxImm(CTX_EXECUTED, stopCounts[k]);
+        e.movImm(EAX, block.startPc + 4 * stopCounts[k]);
+        e.patch(e.jmp(), epilogue);
+    }
+
+    return allocateCode(e.code);
+#else
+    (void)block;
+    return { nullptr, 0 };
+#endif
+}
+
+//===================================================
+//                  HILO COMPILADOR
+//===================================================
+
+JitCompiler::JitCompiler() {}
+
+JitCompiler::~JitCompiler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bStop = true;
+    }
+    cv.notify_all();
+
+    if (worker.joinable())
+        worker.join();
+
+    for (const Result &result : results) {
+        release(result.code);
+    }
+    releaseAll();
+}
+
+bool JitCompiler::available() {
+#ifdef KRONOS_JIT_X86_64
+    return true;
+#else
+    return false;
+#endif
+}
+
+void JitCompiler::request(const Block &block, uint32_t epoch) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back({ block, epoch });
+
+        // El hilo se crea con la primera petición
+        if (!worker.joinable())
+            worker = std::thread(&JitCompiler::workerLoop, this);
+    }
+    cv.notify_one();
+}
+
+std::vector<JitCompiler::Result> JitCompiler::takeResults() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Result> taken;
+    taken.swap(results);
+    bResultsReady.store(false, std::memory_order_release);
+    return taken;
+}
+
+void JitCompiler::keep(const JitCode &code) {
+    installed.push_back(code);
+}
+
+void JitCompiler::releaseAll() {
+    for (const JitCode &code : installed) {
+        release(code);
+    }
+    installed.clear();
+}
+
+void JitCompiler::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        cv.wait(lock, [this] { return bStop || !pending.empty(); });
+        if (bStop)
+            return;
+
+        Request request = std::move(pending.back());
+        pending.pop_back();
+
+        // La compilación se hace sin el cerrojo, el intérprete sigue mientras tanto
+        lock.unlock();
+        JitCode code = compile(request.block);
+        lock.lock();
+
+        if (code.memory != nullptr) {
+            results.push_back({ request.block.startPc, request.epoch, code });
+            bResultsReady.store(true, std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef JIT_H
+#define JIT_H
+
+/*
+    Compilador JIT de bloques básicos a código x86-64.
+
+    Los bloques que más se ejecutan en el motor de bloques se envían a un
+    hilo compilador, que genera el código nativo mientras el intérprete
+    sigue ejecutando. Cuando el código está listo, el motor lo instala en
+    el bloque la siguiente vez que pasa por él.
+
+    Los registros se leen y escriben directamente en CPU::registers, y los
+    accesos a memoria llaman a funciones que usan Memory, así que el estado
+    y los ciclos son los mismos que con el intérprete.
+*/
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "blockengine.h"
+
+class Memory;
+class InstructionCache;
+
+// El JIT solo genera código x86-64
+#if defined(__x86_64__) || defined(_M_X64)
+#define KRONOS_JIT_X86_64
+#endif
+
+// Estado que recibe el código nativo de un bloque
+struct JitContext
+{
+    int32_t *registers;
+    Memory *ram;
+    InstructionCache *icache;
+    uint32_t generation;    // Generación de la caché al entrar al bloque
+    uint32_t executed;      // Instrucciones ejecutadas al salir
+};
+
+// Memoria ejecutable con el código de un bloque
+struct JitCode
+{
+    void *memory;
+    size_t size;
+};
+
+class JitCompiler {
+public:
+    JitCompiler();
+    ~JitCompiler();
+
+    // Número de ejecuciones de un bloque a partir del cual se compila
+    static const uint32_t HOT_THRESHOLD = 64;
+
+    // true si se puede generar código en esta plataforma
+    static bool available();
+
+    // Encola un bloque para compilarlo en segundo plano. Se copia entero,
+    // así que el bloque puede descartarse mientras tanto
+    void request(const Block &block, uint32_t epoch);
+
+    // Código ya compilado pendiente de instalar
+    struct Result {
+        uint32_t startPc;
+        uint32_t epoch;
+        JitCode code;
+    };
+
+    // Recoge los bloques compilados desde la última llamada
+    bool hasResults() const { return bResultsReady.load(std::memory_order_acquire); }
+    std::vector<Result> takeResults();
+
+    // Libera el código de todos los bloques instalados y descartados
+    void releaseAll();
+    void keep(const JitCode &code);
+    static void release(const JitCode &code);
+
+private:
+    struct Request {
+        Block block;
+        uint32_t epoch;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<Request> pending;
+    std::vector<Result> results;
+    std::vector<JitCode> installed;
+    std::atomic<bool> bResultsReady{false};
+    bool bStop = false;
+
+    void workerLoop();
+    static JitCode compile(const Block &block);
+};
+
+#endif // JIT_H
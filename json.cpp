@@ -0,0 +1,339 @@
+#include "json.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+static const JsonValue NULL_VALUE;
+
+const JsonValue& JsonValue::operator[](const std::string &key) const{
+    if (type != Type::Object)
+        return NULL_VALUE;
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == key)
+            return values[i];
+    }
+    return NULL_VALUE;
+}
+
+const JsonValue& JsonValue::operator[](size_t i) const{
+    if (type != Type::Array || i >= array.size())
+        return NULL_VALUE;
+    return array[i];
+}
+
+int JsonValue::toInt(int def) const{
+    return type == Type::Number ? static_cast<int>(number) : def;
+}
+
+double JsonValue::toDouble(double def) const{
+    return type == Type::Number ? number : def;
+}
+
+bool JsonValue::toBool(bool def) const{
+    return type == Type::Bool ? boolean : def;
+}
+
+std::string JsonValue::toString(const std::string &def) const{
+    return type == Type::String ? string : def;
+}
+
+uint32_t JsonValue::toAddress(uint32_t def) const{
+    if (type == Type::Number)
+        return static_cast<uint32_t>(number);
+    if (type != Type::String || string.empty())
+        return def;
+
+    char *end;
+    unsigned long value = std::strtoul(string.c_str(), &end, 16);
+    return (*end == '\0') ? static_cast<uint32_t>(value) : def;
+}
+
+//===================================================
+//                  ANALIZADOR
+//===================================================
+
+namespace {
+
+class Parser {
+public:
+    Parser(const std::string &text) : text(text) {}
+
+    std::string error;
+
+    bool parseDocument(JsonValue &out){
+        skipSpaces();
+        if (!parseValue(out, 0))
+            return false;
+
+        skipSpaces();
+        if (pos != text.size())
+            return fail("contenido después del final");
+        return true;
+    }
+
+private:
+    static const int MAX_DEPTH = 256;
+
+    const std::string &text;
+    size_t pos = 0;
+
+    bool fail(const std::string &message){
+        if (error.empty())
+            error = message + " (posición " + std::to_string(pos) + ")";
+        return false;
+    }
+
+    void skipSpaces(){
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+            pos++;
+    }
+
+    bool consume(const char *word){
+        size_t i = 0;
+        while (word[i] != '\0') {
+            if (pos + i >= text.size() || text[pos + i] != word[i])
+                return false;
+            i++;
+        }
+        pos += i;
+        return true;
+    }
+
+    bool parseValue(JsonValue &out, int depth){
+        if (depth > MAX_DEPTH)
+            return fail("demasiado anidado");
+        if (pos >= text.size())
+            return fail("fin inesperado");
+
+        char c = text[pos];
+        if (c == '{')
+            return parseObject(out, depth);
+        if (c == '[')
+            return parseArray(out, depth);
+        if (c == '"') {
+            out.type = JsonValue::Type::String;
+            return parseString(out.string);
+        }
+        if (c == '-' || (c >= '0' && c <= '9'))
+            return parseNumber(out);
+
+        if (consume("true")) {
+            out.type = JsonValue::Type::Bool;
+            out.boolean = true;
+            return true;
+        }
+        if (consume("false")) {
+            out.type = JsonValue::Type::Bool;
+            out.boolean = false;
+            return true;
+        }
+        if (consume("null")) {
+            out.type = JsonValue::Type::Null;
+            return true;
+        }
+
+        return fail("valor no válido");
+    }
+
+    bool parseObject(JsonValue &out, int depth){
+        out.type = JsonValue::Type::Object;
+        pos++;  // {
+
+        skipSpaces();
+        if (pos < text.size() && text[pos] == '}') {
+            pos++;
+            return true;
+        }
+
+        while (true) {
+            skipSpaces();
+            if (pos >= text.size() || text[pos] != '"')
+                return fail("se esperaba una clave");
+
+            std::string key;
+            if (!parseString(key))
+                return false;
+
+            skipSpaces();
+            if (pos >= text.size() || text[pos] != ':')
+                return fail("se esperaba ':'");
+            pos++;
+
+            skipSpaces();
+            JsonValue value;
+            if (!parseValue(value, depth + 1))
+                return false;
+
+            out.keys.push_back(std::move(key));
+            out.values.push_back(std::move(value));
+
+            skipSpaces();
+            if (pos < text.size() && text[pos] == ',') {
+                pos++;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == '}') {
+                pos++;
+                return true;
+            }
+            return fail("se esperaba ',' o '}'");
+        }
+    }
+
+    bool parseArray(JsonValue &out, int depth){
+        out.type = JsonValue::Type::Array;
+        pos++;  // [
+
+        skipSpaces();
+        if (pos < text.size() && text[pos] == ']') {
+            pos++;
+            return true;
+        }
+
+        while (true) {
+            skipSpaces();
+            JsonValue value;
+            if (!parseValue(value, depth + 1))
+                return false;
+            out.array.push_back(std::move(value));
+
+            skipSpaces();
+            if (pos < text.size() && text[pos] == ',') {
+                pos++;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == ']') {
+                pos++;
+                return true;
+            }
+            return fail("se esperaba ',' o ']'");
+        }
+    }
+
+    bool parseNumber(JsonValue &out){
+        const char *start = text.c_str() + pos;
+        char *end;
+        double value = std::strtod(start, &end);
+        if (end == start)
+            return fail("número no válido");
+
+        out.type = JsonValue::Type::Number;
+        out.number = value;
+        pos += end - start;
+        return true;
+    }
+
+    static void appendUtf8(std::string &out, uint32_t code){
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool parseHex4(uint32_t &code){
+        if (pos + 4 > text.size())
+            return fail("escape \\u incompleto");
+
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = text[pos++];
+            code <<= 4;
+            if (c >= '0' && c <= '9')      code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return fail("escape \\u no válido");
+        }
+        return true;
+    }
+
+    bool parseString(std::string &out){
+        pos++;  // "
+
+        while (pos < text.size()) {
+            char c = text[pos++];
+
+            if (c == '"')
+                return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+
+            if (pos >= text.size())
+                break;
+
+            char escape = text[pos++];
+            switch (escape) {
+            case '"':  out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/'; break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u': {
+                uint32_t code;
+                if (!parseHex4(code))
+                    return false;
+
+                // Par sustituto para los caracteres fuera del plano básico
+                if (code >= 0xD800 && code < 0xDC00 && consume("\\u")) {
+                    uint32_t low;
+                    if (!parseHex4(low))
+                        return false;
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        return fail("par sustituto no válido");
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default:
+                return fail("escape no válido");
+            }
+        }
+
+        return fail("cadena sin cerrar");
+    }
+};
+
+}
+
+int parseJson(const std::string &text, JsonValue &out, std::string *error){
+    Parser parser(text);
+    out = JsonValue();
+
+    if (!parser.parseDocument(out)) {
+        if (error)
+            *error = parser.error;
+        return 1;
+    }
+    return 0;
+}
+
+int readJsonFile(const std::string &filename, JsonValue &out, std::string *error){
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        if (error)
+            *error = "no se pudo abrir " + filename;
+        return 1;
+    }
+
+    std::stringstream ss;
+    ss << file.rdbuf();
+
+    return parseJson(ss.str(), out, error);
+}
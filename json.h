@@ -0,0 +1,51 @@
+#ifndef JSON_H
+#define JSON_H
+
+/*
+    Lector de JSON mínimo para los archivos de configuración y de campaña,
+    de forma que el núcleo del emulador no dependa de Qt. Solo lee; los
+    archivos se siguen generando desde la interfaz.
+*/
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+
+    // Miembros de un objeto, en el orden del archivo
+    std::vector<std::string> keys;
+    std::vector<JsonValue> values;
+
+    bool isNull() const { return type == Type::Null; }
+
+    // Miembro key de un objeto o elemento i de un array. Si no existe se
+    // devuelve un valor nulo, así que se pueden encadenar
+    const JsonValue& operator[](const std::string &key) const;
+    const JsonValue& operator[](size_t i) const;
+    size_t size() const { return type == Type::Array ? array.size() : values.size(); }
+
+    // Conversiones con un valor por defecto si el tipo no es el esperado
+    int toInt(int def = 0) const;
+    double toDouble(double def = 0) const;
+    bool toBool(bool def = false) const;
+    std::string toString(const std::string &def = "") const;
+
+    // Número, o cadena en hexadecimal ("0x80003020" o "80003020")
+    uint32_t toAddress(uint32_t def = 0) const;
+};
+
+// Analiza text. Devuelve 1 si no es JSON válido, con el motivo en error
+int parseJson(const std::string &text, JsonValue &out, std::string *error = nullptr);
+
+// Lee y analiza un archivo. Devuelve 1 si no se puede abrir o no es válido
+int readJsonFile(const std::string &filename, JsonValue &out, std::string *error = nullptr);
+
+#endif // JSON_H
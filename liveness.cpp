@@ -0,0 +1,131 @@
+#include "liveness.h"
+#include <algorithm>
+
+// Registros que lee y escribe una instrucción (0 si ninguno)
+static void registerUse(const PredecodedInst &inst, uint8_t &read1, uint8_t &read2, uint8_t &write){
+    read1 = read2 = write = 0;
+
+    switch (inst.op) {
+    case Operation::ECALL:
+    case Operation::EBREAK:
+    case Operation::NOP:
+        return;
+    default:
+        break;
+    }
+
+    switch (inst.tipo) {
+    case FORMAT_R:
+        read1 = inst.rs1;
+        read2 = inst.rs2;
+        write = inst.rd;
+        break;
+    case FORMAT_I:
+        read1 = inst.rs1;
+        write = inst.rd;
+        break;
+    case FORMAT_S:
+    case FORMAT_B:
+        read1 = inst.rs1;
+        read2 = inst.rs2;
+        break;
+    case FORMAT_U:
+    case FORMAT_J:
+        write = inst.rd;
+        break;
+    default:
+        break;
+    }
+}
+
+void analyzeLiveness(Computer &computer, const Campaign &campaign, uint32_t limit, std::vector<uint32_t> &representative){
+    uint32_t nInjections = campaign.injections.size();
+    representative.resize(nInjections);
+
+    // Inyecciones por ciclo. Las que no se pueden analizar se ejecutan
+    std::vector<uint32_t> order;
+    order.reserve(nInjections);
+    for (uint32_t i = 0; i < nInjections; i++) {
+        representative[i] = i;
+
+        if (campaign.injections[i].reg > 0)
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return campaign.injections[a].cycle < campaign.injections[b].cycle;
+    });
+
+    // Inyecciones de cada registro que esperan al siguiente uso
+    std::vector<uint32_t> pending[32];
+    size_t next = 0;
+
+    // Las que esperan en r se ven afectadas por una lectura: se agrupan por bit
+    auto read = [&](uint8_t r) {
+        uint32_t first[32];
+        std::fill(first, first + 32, DEAD_INJECTION);
+
+        for (uint32_t i : pending[r]) {
+            uint32_t bit = campaign.injections[i].bit;
+            if (first[bit] == DEAD_INJECTION)
+                first[bit] = i;
+            representative[i] = first[bit];
+        }
+        pending[r].clear();
+    };
+
+    // El núcleo clásico para exactamente después de cada instrucción
+    CPU::Core core = computer.cpu.core;
+    computer.cpu.core = CPU::Core::Classic;
+
+    size_t nPending = 0;
+    bool bFinished = false;
+    PredecodedInst scratch;
+
+    while (computer.cpu.cycles < limit) {
+        while (next < order.size() && campaign.injections[order[next]].cycle == computer.cpu.cycles) {
+            uint32_t i = order[next++];
+            pending[campaign.injections[i].reg].push_back(i);
+            nPending++;
+        }
+
+        // Ya no queda nada por decidir
+        if (nPending == 0 && next == order.size())
+            break;
+
+        uint8_t read1, read2, write;
+        registerUse(*computer.cpu.fetchDecoded(computer.cpu.pc, &scratch), read1, read2, write);
+
+        if (read1 != 0 && !pending[read1].empty()) {
+            nPending -= pending[read1].size();
+            read(read1);
+        }
+        if (read2 != 0 && !pending[read2].empty()) {
+            nPending -= pending[read2].size();
+            read(read2);
+        }
+
+        // Sobrescrito sin leerlo: el bit invertido se pierde
+        if (write != 0 && !pending[write].empty()) {
+            for (uint32_t i : pending[write])
+                representative[i] = DEAD_INJECTION;
+            nPending -= pending[write].size();
+            pending[write].clear();
+        }
+
+        if (computer.run(1) != StopReason::Budget) {
+            bFinished = true;
+            break;
+        }
+    }
+
+    computer.cpu.core = core;
+
+    // Si el programa ha terminado, las que siguen esperando no se leen
+    // nunca. Las de después del final se quedan como están y se ejecutan
+    if (bFinished) {
+        for (auto &waiting : pending) {
+            for (uint32_t i : waiting)
+                representative[i] = DEAD_INJECTION;
+        }
+    }
+}
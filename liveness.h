@@ -0,0 +1,34 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+/*
+    Análisis de vida de los registros sobre la ejecución de referencia de
+    una campaña, para no ejecutar las inyecciones cuyo resultado ya se sabe.
+
+    Una inyección invierte un bit del registro r justo antes de la
+    instrucción número c. Lo que pase después solo depende de la siguiente
+    instrucción que use r:
+        - Si lo escribe sin leerlo, o no hay ninguna, el valor invertido no
+          se llega a leer nunca y la inyección es NO_EFFECT.
+        - Si lo lee, todas las inyecciones del mismo registro y bit antes de
+          esa lectura (y después del uso anterior) dejan el mismo estado
+          cuando se llega a ella, así que basta con ejecutar una.
+
+    x0 no se analiza: cada núcleo lo trata a su manera si se invierte.
+*/
+#include <cstdint>
+#include <vector>
+#include "computer.h"
+
+// Valor de representative para las inyecciones que no hace falta ejecutar
+static const uint32_t DEAD_INJECTION = 0xFFFFFFFF;
+
+// Recorre instrucción a instrucción la ejecución de referencia desde el
+// principio (computer recién cargado, con 0 ciclos) hasta que termina o
+// llega a limit. Para cada inyección de campaign deja en representative
+// DEAD_INJECTION o el índice de la inyección que la representa (ella misma
+// si hay que ejecutarla). El recorrido para en cuanto no quedan inyecciones
+// por decidir
+void analyzeLiveness(Computer &computer, const Campaign &campaign, uint32_t limit, std::vector<uint32_t> &representative);
+
+#endif // LIVENESS_H
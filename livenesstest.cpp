@@ -0,0 +1,119 @@
+/*
+    Prueba del análisis de vida de los registros (liveness.h).
+
+    Ejecuta la misma campaña con y sin el análisis y comprueba que cada
+    inyección tiene el mismo resultado: las que se descartan tienen que ser
+    de verdad NO_EFFECT, y las que se juntan tienen que acabar igual que su
+    representante. Comprueba también que el análisis descarta y junta
+    inyecciones, para que la comparación no sea trivial.
+*/
+#include "testprogram.h"
+#include "campaignexecutor.h"
+#include "computer.h"
+#include "liveness.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+static const char *const PROGRAM = "livenesstest.bin";
+static const uint32_t CYCLE_STEP = 3;       // Una de cada tres instrucciones
+static const int BITS[] = { 0, 13, 31 };
+
+// Ejecuta la campaña y deja en results el resultado de cada inyección
+static int runCampaign(const Computer &model, const Campaign &campaign, bool bLiveness, std::vector<uint8_t> &results){
+    CampaignSettings settings;
+    settings.resultAddr = TEST_RESULT_ADDR;
+    settings.bLiveness = bLiveness;
+    settings.threads = 2;
+
+    CampaignExecutor executor;
+    if (executor.start(model, campaign, settings) != 0)
+        return 1;
+
+    while (!executor.finished())
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    results = executor.results();
+    return executor.completed() == campaign.injections.size() ? 0 : 1;
+}
+
+int main(){
+    if (writeProgram(PROGRAM, testProgram()) != 0) {
+        std::cerr << "No se puede escribir " << PROGRAM << std::endl;
+        return 1;
+    }
+
+    Computer model(TEST_MEMORY_SIZE);
+    model.ram.iRomStartAddr = TEST_ROM_START;
+    model.stop.finishAddr = TEST_FINISH_ADDR;
+
+    // Ejecución de referencia
+    model.reset();
+    if (model.LoadProgram(PROGRAM) != 0)
+        return 1;
+    StopReason reason = StopReason::Budget;
+    while (reason == StopReason::Budget && model.cpu.cycles < TEST_LIMIT)
+        reason = model.run(TEST_LIMIT - model.cpu.cycles);
+    if (reason != StopReason::Finished) {
+        std::cerr << "La ejecución de referencia no termina" << std::endl;
+        return 1;
+    }
+
+    Campaign campaign;
+    campaign.programPath = PROGRAM;
+    campaign.expectedInstructions = model.cpu.cycles;
+    campaign.expectedResult = model.ram.readByte(TEST_RESULT_ADDR);
+
+    // Inyecciones en todos los registros a lo largo de toda la ejecución
+    std::vector<Injection> injections;
+    for (uint32_t cycle = 0; cycle < model.cpu.cycles; cycle += CYCLE_STEP) {
+        for (int reg = 1; reg < 32; reg++) {
+            for (int bit : BITS)
+                injections.push_back({ cycle, static_cast<uint8_t>(reg), static_cast<uint8_t>(bit), 0 });
+        }
+    }
+    campaign.injections = InjectionList(std::move(injections));
+    uint32_t nInjections = campaign.injections.size();
+
+    // El análisis tiene que descartar y juntar inyecciones
+    std::vector<uint32_t> representative;
+    model.reset();
+    model.LoadProgram(PROGRAM);
+    analyzeLiveness(model, campaign, campaign.expectedInstructions, representative);
+
+    uint32_t nDead = 0, nMerged = 0;
+    for (uint32_t i = 0; i < nInjections; i++) {
+        if (representative[i] == DEAD_INJECTION)
+            nDead++;
+        else if (representative[i] != i)
+            nMerged++;
+    }
+    check(nDead > 0, "el análisis no descarta ninguna inyección");
+    check(nMerged > 0, "el análisis no junta ninguna inyección");
+
+    std::vector<uint8_t> pruned, full;
+    check(runCampaign(model, campaign, true, pruned) == 0, "la campaña con el análisis no termina");
+    check(runCampaign(model, campaign, false, full) == 0, "la campaña sin el análisis no termina");
+    check(pruned.size() == nInjections && full.size() == nInjections, "faltan resultados");
+
+    uint32_t nDifferent = 0;
+    for (uint32_t i = 0; i < nInjections && pruned.size() == full.size(); i++) {
+        if (pruned[i] != full[i] && nDifferent++ < 10) {
+            const Injection &injection = campaign.injections[i];
+            check(false, "inyección " + std::to_string(i) + " (ciclo " + std::to_string(injection.cycle)
+                         + ", x" + std::to_string(injection.reg) + ", bit " + std::to_string(injection.bit)
+                         + "): " + std::to_string(pruned[i]) + " con el análisis y "
+                         + std::to_string(full[i]) + " sin él");
+        }
+    }
+    check(nDifferent == 0, std::to_string(nDifferent) + " inyecciones con resultado distinto");
+
+    std::remove(PROGRAM);
+
+    if (testFailures > 0)
+        return 1;
+
+    std::cout << "Análisis de vida: " << nInjections << " inyecciones, " << nDead << " descartadas y "
+              << nMerged << " juntadas, todas con el mismo resultado" << std::endl;
+    return 0;
+}
@@ -1,15 +1,11 @@
 #include "mainwindow.h"
+#include "config.h"
 
 #include <QApplication>
-#include <QFile>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
 
-const QString CONFIG_FILE = "./config.json";
+const std::string CONFIG_FILE = "./config.json";
 
-uint ramSize, finish_location, result_location, romAddrAlloc;
-QString disassemblyRouteFile, ramRouteFile, campaignRoute;
+EmulatorConfig config;
 
 int readConfigFile();
 
@@ -32,19 +28,27 @@ int main(int argc, char *argv[])
 
     MainWindow w;
 
-    Computer computer = Computer(ramSize);
+    Computer computer = Computer(config.ramSize);
 
-    computer.ram.iRomStartAddr = romAddrAlloc;  // Localización de la ROM
+    applyConfig(config, computer);  // ROM, núcleo del intérprete, historial y dirección de fin
 
     w.computer = &computer;
-    w.disassemblyFileRoute = disassemblyRouteFile;
-    w.ramFileRoute = ramRouteFile;
-    w.campaignGeneratorRoute = campaignRoute;
+    w.disassemblyFileRoute = QString::fromStdString(config.disassemblyFileRoute);
+    w.ramFileRoute = QString::fromStdString(config.ramFileRoute);
+    w.campaignGeneratorRoute = QString::fromStdString(config.campaignGeneratorRoute);
+    w.goldenCacheRoute = config.goldenCacheRoute;
+    w.campaignCheckpointCount = config.campaignCheckpoints;   // 0 para empezar siempre desde el principio
+    w.campaignHashPoints = config.campaignHashPoints;         // 0 para ejecutar siempre hasta el final
+    w.campaignLiveness = config.campaignLiveness;             // false para ejecutar todas las inyecciones
+    w.campaignThreads = config.campaignThreads;               // 0 para un hilo por núcleo
+    w.campaignConfidence = config.campaignConfidence;         // 0 para no muestrear
+    w.campaignMargin = config.campaignMargin;
+    w.goldenLimit = config.goldenLimit > 0 ? static_cast<uint32_t>(config.goldenLimit) : StopCondition::NONE;
 
     // Direcciones de control, tanto para resultado como para finalizar
     // la ejecución del programa
-    w.RESULT_LOCATION = result_location;
-    w.FINISH_LOCATION = finish_location;
+    w.RESULT_LOCATION = config.resultRamLocation;
+    w.FINISH_LOCATION = config.finishRamLocation;
 
     w.show();
 
@@ -52,55 +56,26 @@ int main(int argc, char *argv[])
 }
 
 int readConfigFile(){
-    // Abrir el archivo JSON
-    QFile file(CONFIG_FILE);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "No se pudo abrir el archivo JSON";
+    // El mismo lector que usa kronos-cli (config.cpp)
+    if (readConfig(CONFIG_FILE, config) != 0)
         return 1;
-    }
-
-    // Leer todo el contenido del archivo JSON
-    QByteArray jsonData = file.readAll();
-
-    // Cerrar el archivo
-    file.close();
-
-    // Crear un QJsonDocument a partir de los datos leídos
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData, &error);
-
-    // Verificar errores de parseo
-    if (jsonDoc.isNull()) {
-        qWarning() << "Error al parsear el archivo JSON:" << error.errorString();
-        return 1;
-    }
-
-    // Verificar si el documento es un objeto JSON
-    if (!jsonDoc.isObject()) {
-        qWarning() << "El archivo JSON no contiene un objeto JSON";
-        return 1;
-    }
-
-    // Obtener el objeto JSON raíz
-    QJsonObject jsonObj = jsonDoc.object();
-
-    // Extraer valores del objeto JSON
-    ramSize = jsonObj["ramSize"].toInt() * 1024 * 1024 * 1024;
-    disassemblyRouteFile = jsonObj["disassemblyFileRoute"].toString();
-    ramRouteFile = jsonObj["ramFileRoute"].toString();
-    campaignRoute = jsonObj["campaignGeneratorRoute"].toString();
-    result_location = jsonObj["resultRamLocation"].toString().toUInt(nullptr, 16);
-    finish_location = jsonObj["finishRamLocation"].toString().toUInt(nullptr, 16);
-    romAddrAlloc = jsonObj["romAddressAllocation"].toString().toUInt(nullptr, 16);
-
 
     // Imprimir los valores extraídos (solo para debug)
-    qDebug() << "Ram Size:" << ramSize / 1024 / 1024 / 1024 << "GB";
-    qDebug() << "Ram file:" << ramRouteFile;
-    qDebug() << "disassembly file:" << disassemblyRouteFile;
-    qDebug() << "campaign route:" << campaignRoute;
-    qDebug() << "Result location:" << result_location;
-    qDebug() << "Finish location:" << finish_location;
+    qDebug() << "Ram Size:" << config.ramSize / 1024 / 1024 / 1024 << "GB";
+    qDebug() << "Ram file:" << QString::fromStdString(config.ramFileRoute);
+    qDebug() << "disassembly file:" << QString::fromStdString(config.disassemblyFileRoute);
+    qDebug() << "campaign route:" << QString::fromStdString(config.campaignGeneratorRoute);
+    qDebug() << "golden cache:" << QString::fromStdString(config.goldenCacheRoute);
+    qDebug() << "Result location:" << config.resultRamLocation;
+    qDebug() << "Finish location:" << config.finishRamLocation;
+    qDebug() << "Interpreter core:" << QString::fromStdString(config.interpreterCore);
+    qDebug() << "Disassembly history:" << config.disassemblyHistory;
+    qDebug() << "Campaign checkpoints:" << config.campaignCheckpoints;
+    qDebug() << "Campaign hash points:" << config.campaignHashPoints;
+    qDebug() << "Campaign liveness:" << config.campaignLiveness;
+    qDebug() << "Campaign threads:" << config.campaignThreads;
+    qDebug() << "Campaign confidence:" << config.campaignConfidence << "margin:" << config.campaignMargin;
+    qDebug() << "Golden limit:" << config.goldenLimit;
 
     return 0;
 }
@@ -1,23 +1,33 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
+#include "campaigngenerator.h"
+#include "goldencache.h"
+#include <chrono>
+#include <climits>
 #include <cstdlib>
 #include <QFileDialog>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
 #include <QDesktopServices>
 #include <QTimer>
 #include <QDateTime>
 #include <QInputDialog>
 #include <QMessageBox>
 
-
-enum CampaignResult{
-    NO_EFFECT,
-    SDC,
-    SED,
-    DUE
-};
+// Instrucciones que se ejecutan en cada iteración del QTimer de la ejecución
+// completa. Entre una ráfaga y otra se actualiza la interfaz
+const uint32_t RUN_BURST = 10000;
+
+// Cada cuánto se consulta el progreso de una campaña (ms)
+const int CAMPAIGN_POLL_MS = 100;
+
+// Ordenador con la configuración de computer (memoria, ROM, núcleo y
+// dirección de fin), para las ejecuciones de referencia en otros hilos
+static std::shared_ptr<Computer> configuredCopy(const Computer &computer){
+    std::shared_ptr<Computer> copy = std::make_shared<Computer>(computer.ram.iMemorySize);
+    copy->ram.iRomStartAddr = computer.ram.iRomStartAddr;
+    copy->cpu.core = computer.cpu.core;
+    copy->stop.finishAddr = computer.stop.finishAddr;
+    return copy;
+}
 
 
 MainWindow::MainWindow(QWidget *parent, Computer *comp)
@@ -48,9 +58,8 @@ MainWindow::MainWindow(QWidget *parent, Computer *comp)
     // botones como el botón de pausa.
     connect(this, &MainWindow::runProgram, this, &MainWindow::on_runButton_clicked);
     connect(this, &MainWindow::runProgramCompleted, this, &MainWindow::updateCampaignAfterProgramExecution);
-    connect(this, &MainWindow::runCampaignIter, this, &MainWindow::iterationCampaign);
+    connect(this, &MainWindow::runCampaign, this, &MainWindow::startCampaign);
     connect(this, &MainWindow::campaignComplete, this, &MainWindow::onCampaignComplete);
-    connect(this, &MainWindow::campaignIterComplete, this, &MainWindow::onFinishIter);
 }
 
 MainWindow::~MainWindow()
@@ -123,8 +132,11 @@ int MainWindow::on_runButton_clicked()
     //
     // No le da tiempo a renderizar, así que necesito que espere a que termine la iteración
     // con el renderizado.
-    // Realmente no pasa nada porque el emulador no tenga una velocidad vertiginosa
-    // (que la tiene), ya que lo importante es que lleve bien el número de instrucciones
+    // En cada iteración se ejecuta una ráfaga de RUN_BURST instrucciones con
+    // Computer::run, y se renderiza una vez al final de la ráfaga
+
+    // La ejecución previa a una campaña solo necesita el resultado y los ciclos
+    computer->cpu.stats = isExecutingBeforeCampaign ? StatsLevel::None : StatsLevel::PerOpcode;
 
     QTimer *timer = new QTimer(this);
 
@@ -137,96 +149,57 @@ int MainWindow::on_runButton_clicked()
 }
 
 
-// Realiza un ciclo de ejecución (fetch, decode y execute)
+// Realiza una ráfaga de ciclos de ejecución (fetch, decode y execute)
 void MainWindow::runLoopIteration()
 {
+    StopReason reason = StopReason::Budget;
+
+    if (!stopExec) {
+        // Para antes si se escribe un 0 en la posición FINISH_LOCATION
+        reason = computer->run(RUN_BURST);
+
+        if(!this->isExecutingBeforeCampaign)    // Para no mostrar la primera ejecución del programa en una campaña
+            this->UpdateInterface();
+    }
 
-    // Al escribir en la posición FINISH_LOCATION un 0, para la ejecución del programa
-    if (computer->ram.readByte(FINISH_LOCATION) == 0 || stopExec) {
+    if (reason == StopReason::Finished || reason == StopReason::Trap || stopExec) {
 
         sender()->deleteLater(); // Eliminar el QTimer después de terminar el bucle
 
+        if (reason == StopReason::Trap) {
+            // Si era la ejecución de referencia de una campaña, la campaña no sigue
+            isExecutingBeforeCampaign = false;
+            this->UpdateInterface();
+            showTrap();
+        }
+
         // Esto es para que, en caso de que se haya ejecutado por una campaña, siga con la campaña
-        if(this->isExecutingBeforeCampaign)
+        else if(this->isExecutingBeforeCampaign)
             emit runProgramCompleted();
 
-        else if(computer->ram.readByte(FINISH_LOCATION) == 0){
+        else if(reason == StopReason::Finished){
 
             ui->generateStatsButton->setEnabled(true);
             QMessageBox::information(nullptr, "Programa finalizado", "La ejecución del programa ha finalizado");
 
         }
-        return;
     }
-
-    // Ejecutar una iteración del bucle
-    computer->cpu.clock();
-
-    if(!this->isExecutingBeforeCampaign)    // Para no mostrar la primera ejecución del programa en una campaña
-        this->UpdateInterface();
 }
 
-// Realiza un ciclo de ejecución de la campaña
-void MainWindow::runLoopIterationCampaign()
-{
-    qDebug() << computer->cpu.cycles;
-
-    if (computer->ram.readByte(FINISH_LOCATION) == 0) {
-
-        // Al escribir en la posición FINISH_LOCATION un 0, para la ejecución del programa
-        if(computer->ram.readByte(RESULT_LOCATION) != computer->campaign.expectedResult){
-
-            // Resultado final: Silent Data Corruption (SDC)
-            this->campaignResults.push_back(SDC);
-
-        }
-        else if(computer->campaign.expectedInstructions > computer->cpu.cycles){
 
-            // Resultado final: Single Event Delay (SED)
-            this->campaignResults.push_back(SED);
 
-        } else {
 
-            // Resultado final: NO EFFECT
-            this->campaignResults.push_back(NO_EFFECT);
-
-        }
-
-        this->injectionNumber++;    // Inyección por la que va
-
-        sender()->deleteLater(); // Eliminar el QTimer después de terminar el bucle
-        emit campaignIterComplete();
-        return;
-    }
-
-
-    // Si aún no ha tardado el doble en ejecuctarse, sigue ejecutándose.
-    if(computer->campaign.expectedInstructions * 2 > computer->cpu.cycles){
-
-        if(computer->cpu.cycles == this->injectionNumber){
-            int inst = computer->cpu.cycles;    // número de instrucción
-            int reg = computer->campaign.injections[inst][1];   // Registro a cambiar
-            computer->cpu.registers[reg] ^= (1 << computer->campaign.injections[inst][2]); // invierte el bit utilizando XOR
-        }
-
-    }else{
-        // Resultado final: Detected Unrecovery Error (DUE)
-        this->campaignResults.push_back(DUE);
-
-        this->injectionNumber++;
-
-        sender()->deleteLater(); // Eliminar el QTimer después de terminar el bucle
-
-        emit campaignIterComplete();
-        return;
-    }
-
-    // Ejecutar una iteración del bucle
-    computer->cpu.clock();
+// Muestra la excepción que ha parado la ejecución
+void MainWindow::showTrap()
+{
+    const CPU &cpu = computer->cpu;
+    QMessageBox::warning(nullptr, "Excepción",
+                         QString("%1\nPC: 0x%2\nDirección: 0x%3")
+                             .arg(QString::fromUtf8(trapName(cpu.trap)))
+                             .arg(cpu.trapPc, 8, 16, QChar('0'))
+                             .arg(cpu.trapAddr, 8, 16, QChar('0')));
 }
 
-
-
 // Botón de reset
 void MainWindow::on_stopButton_clicked()
 {
@@ -244,9 +217,14 @@ void MainWindow::on_pauseButton_clicked()
 // Botón para ejecutar solo un paso del programa
 void MainWindow::on_runPasoButton_clicked()
 {
-    if (computer->ram.readByte(FINISH_LOCATION) != 0) {
+    if (computer->cpu.trap != Trap::None) {
+        showTrap();
+    } else if (computer->ram.readByte(FINISH_LOCATION) != 0) {
         computer->cpu.clock();
         this->UpdateInterface();
+
+        if (computer->cpu.trap != Trap::None)
+            showTrap();
     } else {
         QMessageBox::information(nullptr, "Programa finalizado", "La ejecución del programa ha finalizado");
         ui->generateStatsButton->setEnabled(true);  // Se habilita el botón para generar estadísticas del emulador
@@ -368,7 +346,9 @@ void MainWindow::on_exportRamButton_clicked()
 
         // Escribir los datos en el archivo
         for (size_t i = 0; i < computer->ram_size; i+=4) {
-            out << static_cast<quint32>(computer->ram.readWord(i)); // Escribir cada byte como un entero de 8 bits sin signo
+            // QDataStream escribe en big-endian: se voltea la palabra para que
+            // el archivo tenga los bytes en el mismo orden que la memoria
+            out << static_cast<quint32>(FlipWord(computer->ram.readWord(i)));
         }
 
         // Cerrar el archivo
@@ -391,6 +371,7 @@ void MainWindow::resetInterface(){
     ui->generateStatsButton->setEnabled(false);
 
     ui->codeDisassemblyText->clear();
+    disassemblyShown = 0;
     ui->ramText->setPlainText(QString::fromStdString(computer->showRam(pageToView)));
     ui->registerText->setPlainText(QString::fromStdString(computer->showRegisters()));
     ui->terminalBox->setPlainText("");
@@ -404,13 +385,22 @@ void MainWindow::UpdateInterface()
     UpdateTerminal();    // Update terminalBox
     ui->ramText->setPlainText(QString::fromStdString(computer->showRam(pageToView)));   // Update ramBox
     ui->registerText->setPlainText(QString::fromStdString(computer->showRegisters()));  // Update registerBox
-    ui->codeDisassemblyText->appendPlainText(QString::fromStdString(computer->showDisassembly()));  // Update disassembly
+
+    // Update disassembly: las instrucciones nuevas desde la última actualización
+    uint64_t executed = computer->cpu.history.pushed();
+    if (disassemblyShown > executed)
+        disassemblyShown = 0;   // Se ha reseteado la CPU
+    if (disassemblyShown < executed) {
+        ui->codeDisassemblyText->appendPlainText(QString::fromStdString(computer->showDisassembly(disassemblyShown)));
+        disassemblyShown = executed;
+    }
 }
 
 void MainWindow::UpdateTerminal(){
     ui->terminalBox->setPlainText("");
     for(int i = 0; i < 20; i++){
-        ui->terminalBox->appendPlainText(computer->showVRAMLine(i));
+        std::string line = computer->showVRAMLine(i);
+        ui->terminalBox->appendPlainText(QString::fromLatin1(line.data(), line.size()));
     }
 }
 
@@ -418,6 +408,11 @@ void MainWindow::UpdateTerminal(){
 
 void MainWindow::on_actionGenerar_campa_a_aleatoria_triggered()
 {
+    if (generatorTask.valid()) {
+        QMessageBox::information(nullptr, "Información", "Ya se está generando una campaña");
+        return;
+    }
+
     QMessageBox::information(nullptr, "Indique un archivo", "Por favor, indique el programa al que se le asignará la campaña");
     QString program = QFileDialog::getOpenFileName(nullptr, "Seleccionar archivo", "", "Archivos (*.bin *.o)");
 
@@ -439,149 +434,173 @@ void MainWindow::on_actionGenerar_campa_a_aleatoria_triggered()
         QString programName =  "campaign_" + currentDay + "_" + currentTime;
 
 
-        int instructions = 0;
+        bool ok;
+        int count = QInputDialog::getInt(this, "Generar campaña", "Número de inyecciones:", 1000, 1, INT_MAX, 1, &ok);
+        if (!ok)
+            return;
 
-        QJsonObject jsonObject;
+        // La ejecución de referencia se hace en un ordenador aparte y en
+        // otro hilo, así que ni el programa cargado ni la interfaz se tocan
+        GeneratorSettings settings;
+        settings.count = count;
+        settings.seed = QDateTime::currentMSecsSinceEpoch();
+        settings.resultAddr = RESULT_LOCATION;
+        settings.limit = goldenLimit;
+        settings.threads = campaignThreads;
+        settings.cacheDir = goldenCacheRoute;
+        generatorSeed = settings.seed;
 
-        jsonObject["program"] = program;
+        std::shared_ptr<Computer> model = configuredCopy(*computer);
+        std::string programPath = program.toStdString();
+        std::string campaignFile = (campaignGeneratorRoute + "/" + programName + ".kcamp").toStdString();
 
-        jsonObject["expectedResult"] = 0;
-        jsonObject["expectedInstructions"] = 0;
+        generatorTask = std::async(std::launch::async, [model, programPath, settings, campaignFile]() {
+            return generateCampaign(*model, programPath, settings, campaignFile);
+        });
 
-        // JSONARRAY para las inyecciones
-        QJsonArray injectionsArr;
+        QTimer *timerGenerator = new QTimer(this);
+        connect(timerGenerator, &QTimer::timeout, this, &MainWindow::pollGenerator);
+        timerGenerator->start(CAMPAIGN_POLL_MS);
 
-        for (int i = 0; i < 1000; ++i) {
-            int inst = i;
-            int reg = std::rand() % 32;
-            int bit = std::rand() % 8;
+    } else {
+        qDebug() << "Error al abrir el archivo";
+    }
+}
 
-            QJsonArray injection;
-            injection.append(inst);
-            injection.append(reg);
-            injection.append(bit);
+// Avisa cuando termina la generación de la campaña
+void MainWindow::pollGenerator(){
+    if (generatorTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
 
-            injectionsArr.append(injection);
-        }
+    sender()->deleteLater(); // Eliminar el QTimer al terminar
 
+    if (generatorTask.get() == 0) {
+        qDebug() << "Campaña generada con éxito. Semilla:" << generatorSeed;
 
+        QMessageBox::information(nullptr, "Información", "Campaña generada con éxito en: " + campaignGeneratorRoute);
+    } else {
+        qDebug() << "Error al generar la campaña.";
+        QMessageBox::warning(nullptr, "Error", "No se ha podido generar la campaña. ¿Termina el programa?");
+    }
+}
 
-        jsonObject["injections"] = injectionsArr;
+void MainWindow::on_executeCampaignButton_clicked()
+{
+    if(computer->campaign.expectedInstructions != 0){
+        launchCampaign();
+        return;
+    }
 
+    // Si la campaña no trae la ejecución de referencia, se busca en la caché
+    // o se hace en un ordenador aparte y en otro hilo, con el límite de
+    // goldenLimit instrucciones para que un programa que no termina no se
+    // quede ejecutando sin fin
+    if (goldenTask.valid())
+        return;     // Ya hay una en marcha
 
+    std::shared_ptr<Computer> model = configuredCopy(*computer);
+    std::string program = computer->campaign.programPath;
+    goldenProgram = program;
+    uint32_t resultAddr = RESULT_LOCATION;
+    uint32_t limit = goldenLimit;
+    std::string cacheDir = goldenCacheRoute;
 
+    goldenTask = std::async(std::launch::async, [this, model, program, resultAddr, limit, cacheDir]() {
+        return findGolden(*model, program, resultAddr, limit, cacheDir, goldenRun);
+    });
 
-        // Convertir el objeto JSON en un documento JSON
-        QJsonDocument jsonDocument(jsonObject);
+    ui->executeCampaignButton->setEnabled(false);
 
-        // Convertir el documento JSON en una cadena formateada
-        QByteArray jsonData = jsonDocument.toJson(QJsonDocument::Indented);
+    QTimer *timerGolden = new QTimer(this);
+    connect(timerGolden, &QTimer::timeout, this, &MainWindow::pollGolden);
+    timerGolden->start(CAMPAIGN_POLL_MS);
+}
 
-        // Escribir la cadena JSON en un archivo
-        QFile jsonFile(campaignGeneratorRoute + "/" + programName + ".json");
-        if (jsonFile.open(QFile::WriteOnly | QFile::Truncate)) {
-            jsonFile.write(jsonData);
-            jsonFile.close();
-            qDebug() << "Campaña generada con éxito.";
+// Espera a la ejecución de referencia y lanza la campaña
+void MainWindow::pollGolden(){
+    if (goldenTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
 
-            QMessageBox::information(nullptr, "Información", "Campaña generada con éxito en: " + campaignGeneratorRoute);
-        } else {
-            qDebug() << "Error al generar campaña para escritura.";
-        }
+    sender()->deleteLater(); // Eliminar el QTimer al terminar
 
-    } else {
-        qDebug() << "Error al abrir el archivo";
-    }
-}
+    ui->executeCampaignButton->setEnabled(true);
 
+    int error = goldenTask.get();
+    if (computer->campaign.programPath != goldenProgram)
+        return;     // Se ha cargado otra campaña mientras tanto
 
-void MainWindow::on_executeCampaignButton_clicked()
-{
-    // Si la campaña no tiene un programa configurado...
-    if(computer->campaign.expectedInstructions == 0){
+    if (error == 0) {
+        qDebug() << "Instrucciones:" << goldenRun.instructions;
+        qDebug() << "Resultado esperado:" << goldenRun.result;
 
-        isExecutingBeforeCampaign = true;
+        computer->campaign.expectedInstructions = goldenRun.instructions;
+        computer->campaign.expectedResult = goldenRun.result;
 
-        // Carga del programa que hay asociado a la campaña
-        computer->LoadProgram(computer->campaign.programPath.toStdString());
+        launchCampaign();
+        return;
+    }
 
-        emit runProgram();
+    // Si no se ha podido, se ejecuta el programa en la interfaz, donde se
+    // puede parar y ver en qué se queda
+    isExecutingBeforeCampaign = true;
 
-    } else {
-        ui->progressBar->setMaximum(computer->campaign.injections.size());
-        ui->executingCampaignBox->setVisible(true);
+    // Carga del programa que hay asociado a la campaña
+    computer->LoadProgram(computer->campaign.programPath);
 
-        emit runCampaignIter();
+    emit runProgram();
+}
 
-    }
+// Muestra la barra de progreso y lanza la campaña, que ya tiene su
+// ejecución de referencia
+void MainWindow::launchCampaign(){
+    ui->progressBar->setMaximum(computer->campaign.injections.size());
+    ui->executingCampaignBox->setVisible(true);
 
+    emit runCampaign();
 }
 
-void MainWindow::iterationCampaign(){
-    // Ejecución de la campaña
-    computer->reset();
-    computer->LoadProgram(computer->campaign.programPath.toStdString());
+// Lanza todas las inyecciones de la campaña en segundo plano
+void MainWindow::startCampaign(){
+    CampaignSettings settings;
+    settings.resultAddr = RESULT_LOCATION;
+    settings.checkpointCount = campaignCheckpointCount;
+    settings.hashPointCount = campaignHashPoints;
+    settings.bLiveness = campaignLiveness;
+    settings.threads = campaignThreads;
+    settings.confidence = campaignConfidence;
+    settings.margin = campaignMargin;
+
+    if (campaignExecutor.start(*computer, computer->campaign, settings) != 0) {
+        qWarning() << "Ya hay una campaña en ejecución";
+        return;
+    }
 
-    // Ejecución de la campaña
     QTimer *timerCampaign = new QTimer(this);
+    connect(timerCampaign, &QTimer::timeout, this, &MainWindow::pollCampaign);
+    timerCampaign->start(CAMPAIGN_POLL_MS);
+}
 
-    // Conectar el timeout del QTimer al slot para ejecutar una iteración del bucle
-    // Usar un lambda para capturar y pasar el parámetro
-    connect(timerCampaign, &QTimer::timeout, this, &MainWindow::runLoopIterationCampaign);
-
-    timerCampaign->start();
+// Actualiza la barra de progreso y, al terminar, recoge los resultados
+void MainWindow::pollCampaign(){
+    ui->progressBar->setValue(campaignExecutor.completed());
 
-    qDebug() << "fin";
+    if (!campaignExecutor.finished())
+        return;
 
-    //computer->reset();
-}
+    sender()->deleteLater(); // Eliminar el QTimer al terminar la campaña
 
-void MainWindow::onFinishIter(){
-    ui->progressBar->setValue(injectionNumber);
+    const std::vector<uint8_t> &results = campaignExecutor.results();
+    campaignResults.assign(results.begin(), results.end());
 
-    if(this->injectionNumber == computer->campaign.injections.size()-1)
-        emit campaignComplete();
-    else
-        emit runCampaignIter();
+    emit campaignComplete();
 }
 
 // Cuando se completa la ejecución de la campaña
 // se llama a este método para imprimir las estadísticas
 void MainWindow::onCampaignComplete(){
 
-    QString str = "";
-    float noeffect = 0, sdc = 0, sed = 0, due = 0;
-
-    int hundred = campaignResults.size();
-
-    foreach (int res, campaignResults) {
-        switch (res) {
-        case NO_EFFECT:
-            noeffect++;
-            break;
-        case SDC:
-            sdc++;
-            break;
-        case SED:
-            sed++;
-            break;
-        case DUE:
-            due++;
-            break;
-        }
-    }
-
-    // Cálculo de porcentajes
-    noeffect = (noeffect * 100) / hundred;
-    sdc = (sdc * 100) / hundred;
-    sed = (sed * 100) / hundred;
-    due = (due * 100) / hundred;
-
-    str = QString("Resultados de la campaña:\nNo effect: %1%\nSDC: %2%\nSED: %3%\nDUE: %4%")
-                  .arg(noeffect, 0, 'f', 2)
-                  .arg(sdc, 0, 'f', 2)
-                  .arg(sed, 0, 'f', 2)
-                  .arg(due, 0, 'f', 2);
+    QString str = QString::fromStdString(campaignSummary(campaignResults, campaignConfidence,
+                                                         computer->campaign.injections.size()));
 
 
     ui->executingCampaignBox->setVisible(false);    // Dejamos de renderizar la barra de carga
@@ -605,10 +624,7 @@ void MainWindow::updateCampaignAfterProgramExecution(){
     computer->campaign.expectedInstructions = computer->cpu.cycles;
     computer->campaign.expectedResult = resultEsperado;
 
-    ui->progressBar->setMaximum(computer->campaign.injections.size());
-    ui->executingCampaignBox->setVisible(true);
-
-    emit runCampaignIter();
+    launchCampaign();
 
 }
 
@@ -622,7 +638,7 @@ void MainWindow::on_loadCampaignButton_clicked()
 void MainWindow::loadCampaign(){
 
     // Abre un explorador de archivos para que seleccione el usuario el json específico
-    QString nombreArchivo = QFileDialog::getOpenFileName(this, "Seleccionar archivo", "", "*.json");
+    QString nombreArchivo = QFileDialog::getOpenFileName(this, "Seleccionar archivo", "", "*.json *.kcamp");
 
     if (!nombreArchivo.isEmpty()) {
 
@@ -636,7 +652,7 @@ void MainWindow::loadCampaign(){
         computer->LoadCampaign(nombreArchivo.toStdString());
         ui->campaignNameText->setText(filename);
 
-        QFileInfo programInfo(computer->campaign.programPath);
+        QFileInfo programInfo(QString::fromStdString(computer->campaign.programPath));
         QString programName = programInfo.fileName();
 
         ui->filenameText->setText(programName);
@@ -2,7 +2,10 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <future>
+#include "campaignexecutor.h"
 #include "computer.h"
+#include "goldencache.h"
 #include "statsdialog.h"
 
 QT_BEGIN_NAMESPACE
@@ -25,9 +28,16 @@ public:
     QString disassemblyFileRoute;
     QString ramFileRoute;
     QString campaignGeneratorRoute;
+    std::string goldenCacheRoute;           // Caché de las ejecuciones de referencia
 
-    std::vector<int> campaignResults;
-    int injectionNumber = 0;
+    std::vector<uint8_t> campaignResults;
+    uint32_t campaignCheckpointCount = 64;  // Puntos de control de la ejecución de referencia
+    uint32_t campaignHashPoints = 1024;     // Hashes del estado para cortar las inyecciones enmascaradas
+    bool campaignLiveness = true;           // Descartar las inyecciones en registros muertos
+    unsigned campaignThreads = 0;           // Hilos de las campañas, 0 para uno por núcleo
+    double campaignConfidence = 0;          // Muestrear hasta este nivel de confianza (0 para no muestrear)
+    double campaignMargin = 0.01;           // con este margen de error
+    uint32_t goldenLimit = StopCondition::NONE;    // Instrucciones de la ejecución de referencia
 
     uint32_t FINISH_LOCATION, RESULT_LOCATION;
 
@@ -61,20 +71,20 @@ private slots:
     void on_actionGenerar_campa_a_aleatoria_triggered();
 
     void on_executeCampaignButton_clicked();
-    void iterationCampaign();
+    void startCampaign();
+    void pollCampaign();
+    void pollGolden();
+    void pollGenerator();
 
-    void runLoopIterationCampaign();
     void on_loadCampaignButton_clicked();
 
     void onCampaignComplete();
-    void onFinishIter();
 signals:
     void runProgram();
     void runProgramCompleted();
 
-    void runCampaignIter();
+    void runCampaign();
 
-    void campaignIterComplete();
     void campaignComplete();
 
 private:
@@ -86,9 +96,27 @@ private:
     bool stopExec;
     bool isExecutingBeforeCampaign;
 
+    // Ejecuta las inyecciones de la campaña en otros hilos. La interfaz
+    // solo consulta el progreso con un QTimer
+    CampaignExecutor campaignExecutor;
+
+    // La ejecución de referencia de la campaña también se hace en otro hilo,
+    // sobre una copia de la configuración del ordenador (ver pollGolden())
+    GoldenRun goldenRun;
+    std::string goldenProgram;      // Programa de goldenRun
+    std::future<int> goldenTask;
+
+    // Generación de campañas en otro hilo (ver pollGenerator())
+    uint64_t generatorSeed = 0;
+    std::future<int> generatorTask;
+
+    uint64_t disassemblyShown = 0;  // Instrucciones del historial ya mostradas
+
     void UpdateInterface();
+    void showTrap();
 
     void loadCampaign();
+    void launchCampaign();
     void updateCampaignAfterProgramExecution();
 
     void UpdateTerminal();
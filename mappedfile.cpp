@@ -0,0 +1,97 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile(){
+    close();
+}
+
+#ifdef _WIN32
+
+int MappedFile::open(const std::string &filename){
+    close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return 1;
+    hFile = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        close();
+        return 1;
+    }
+
+    hMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (hMapping == nullptr) {
+        close();
+        return 1;
+    }
+
+    pData = static_cast<const uint8_t*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (pData == nullptr) {
+        close();
+        return 1;
+    }
+
+    iSize = static_cast<size_t>(size.QuadPart);
+    return 0;
+}
+
+void MappedFile::close(){
+    if (pData)
+        UnmapViewOfFile(pData);
+    if (hMapping)
+        CloseHandle(hMapping);
+    if (hFile)
+        CloseHandle(hFile);
+
+    pData = nullptr;
+    iSize = 0;
+    hMapping = nullptr;
+    hFile = nullptr;
+}
+
+#else
+
+int MappedFile::open(const std::string &filename){
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return 1;
+    }
+
+    // El mapeo sigue siendo válido después de cerrar el descriptor
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return 1;
+
+    pData = static_cast<const uint8_t*>(data);
+    iSize = info.st_size;
+    return 0;
+}
+
+void MappedFile::close(){
+    if (pData)
+        munmap(const_cast<uint8_t*>(pData), iSize);
+
+    pData = nullptr;
+    iSize = 0;
+}
+
+#endif
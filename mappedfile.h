@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+/*
+    Archivo de solo lectura mapeado en memoria (mmap en POSIX, un file
+    mapping en Windows). El sistema solo carga las páginas que se leen.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Devuelve 1 si no se puede abrir o mapear
+    int open(const std::string &filename);
+    void close();
+
+    const uint8_t* data() const { return pData; }
+    size_t size() const { return iSize; }
+
+private:
+    const uint8_t *pData = nullptr;
+    size_t iSize = 0;
+
+#ifdef _WIN32
+    void *hFile = nullptr;
+    void *hMapping = nullptr;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -1,114 +1,299 @@
 #include "memory.h"
-#include <thread>
-#include <vector>
+
+// Página que se devuelve al leer de una página que no se ha escrito nunca
+static const uint8_t* blankPage(){
+    static uint8_t page[Memory::PAGE_SIZE];
+    static bool bFilled = (std::memset(page, Memory::RESET_VALUE, sizeof(page)), true);
+    (void)bFilled;
+    return page;
+}
 
 Memory::Memory(uint32_t MEMORY_SIZE){
     iMemorySize = MEMORY_SIZE;
-    memory = new uint8_t[MEMORY_SIZE];
 
-    this->reset();
+    for (uint32_t i = 0; i < DIRECTORY_SIZE; i++)
+        directory[i] = nullptr;
+    flushTlb();
+
+    this->resetIOMemory();
 
     this->iRomStartAddr = 0;
 };
 
 
-Memory::~Memory(){};
+Memory::~Memory(){
+    releaseTables();
 
-void Memory::writeByte(uint32_t addr, int8_t data) {
+    for (Page *page : freePages)
+        delete page;
+};
 
-    if(addr <= iMemorySize && addr >= 0){
-        memory[addr] = data;
-    }
+void Memory::reset(){
+
+    // Sin tablas toda la memoria se lee como recién reseteada. Solo hay
+    // que soltar lo que se ha escrito
+    releaseTables();
+
+    this->resetIOMemory();
+
+    // Todo lo que hubiera decodificado ya no es válido
+    if(pICache)
+        pICache->clear();
 
 }
-void Memory::writeHalf(uint32_t addr, int16_t data) {
 
-    if(addr <= iMemorySize && addr >= 0){
-        memory[addr] = data >> 8;
-        memory[addr + 1] = data;
+void Memory::resetIOMemory(){
+    // Directamente sobre las páginas, para no tocar la caché ni la dirección vigilada
+    for (uint32_t i = this->iMemorySize - this->pIo; i < this->iMemorySize; ++i) {
+        pageForWrite(i)[i & PAGE_MASK] = 0x20; // Caracter de espacio en utf8
+    }
+}
+
+std::shared_ptr<const MemorySnapshot> Memory::snapshot(){
+    std::shared_ptr<MemorySnapshot> snap(new MemorySnapshot);
+
+    snap->iMemorySize = iMemorySize;
+    snap->usedTables = usedTables;
+    for (uint32_t i = 0; i < DIRECTORY_SIZE; i++)
+        snap->directory[i] = nullptr;
+
+    for (uint32_t i : usedTables) {
+        directory[i]->refs++;
+        snap->directory[i] = directory[i];
     }
 
+    // Ahora todas las páginas están compartidas: la siguiente escritura en
+    // cada una tiene que pasar por refillWrite para copiarla
+    for (uint32_t i = 0; i < TLB_SIZE; i++)
+        writeTlb[i] = { NO_PAGE, nullptr };
 
+    return snap;
 }
-void Memory::writeWord(uint32_t addr, int32_t data){
 
-    if(addr <= iMemorySize && addr >= 0){
-        // 00 00 00 00
-        memory[addr] = data >> 24;
-        memory[addr + 1] = data >> 16;
-        memory[addr + 2] = data >> 8;
-        memory[addr + 3] = data;
+void Memory::restore(const MemorySnapshot &snap){
+    if (snap.iMemorySize != iMemorySize)
+        return;
+
+    // Solo se invalida el código de las páginas que no son las mismas
+    if (pICache && pICache->iSize > 0) {
+        uint32_t first = pICache->iStart >> PAGE_BITS;
+        uint32_t last = (pICache->iStart + pICache->iSize - 1) >> PAGE_BITS;
+
+        for (uint32_t page = first; page <= last; page++) {
+            if (findPage(directory, page) != findPage(snap.directory, page))
+                pICache->invalidateRange(page << PAGE_BITS, PAGE_SIZE);
+        }
     }
 
-};
+    // Las tablas de la instantánea se comparten, no se copian
+    for (uint32_t i : snap.usedTables)
+        snap.directory[i]->refs++;
 
-uint8_t Memory::readByte(uint32_t addr) {
-    if(addr <= iMemorySize && addr >= 0)
-        return memory[addr];
-    else
-        return 0;
-}
-uint16_t Memory::readHalf(uint32_t addr) {
-    if(addr <= iMemorySize && addr >= 0){
-        uint16_t half = (memory[addr + 2] << 8) | memory[addr + 3];
-        return half;
-    }else{
-        return 0;
+    releaseTables();
+
+    usedTables = snap.usedTables;
+    for (uint32_t i : usedTables)
+        directory[i] = snap.directory[i];
+}
+
+void Memory::clearDirty(){
+    vDirtyPages.clear();
+
+    // Para que la siguiente escritura en cada página pase por refillWrite
+    for (uint32_t i = 0; i < TLB_SIZE; i++)
+        writeTlb[i] = { NO_PAGE, nullptr };
+}
+
+static inline uint64_t mix64(uint64_t x){
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t hashData(const uint8_t *data){
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+    for (uint32_t i = 0; i < Memory::PAGE_SIZE; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash += word * 0xC2B2AE3D27D4EB4Full;
+        hash = ((hash << 31) | (hash >> 33)) * 0x9E3779B97F4A7C15ull;
     }
+    return hash;
+}
+
+uint64_t Memory::hashPage(uint32_t page, const uint8_t *data){
+    // Se le quita el hash de la página en blanco para que valga 0 sin
+    // escribir, y así no haga falta contar las páginas que no existen
+    static const uint64_t blankHash = hashData(blankPage());
 
+    uint64_t position = page * 0x9E3779B97F4A7C15ull;
+    return mix64(hashData(data) ^ position) ^ mix64(blankHash ^ position);
+}
+
+uint64_t Memory::pageHash(uint32_t page){
+    Page *found = findPage(directory, page);
+    return found ? hashPage(page, found->data) : 0;
 }
-uint32_t Memory::readWord(uint32_t addr){
-    if(addr <= iMemorySize && addr >= 0){
-        uint32_t word = (memory[addr] << 24) | (memory[addr + 1] << 16) | (memory[addr + 2] << 8) | memory[addr + 3];
-        return word;
-    }else
-        return 0;
-};
 
+uint64_t Memory::contentHash(){
+    uint64_t hash = 0;
 
-void Memory::reset(){
+    for (uint32_t i : usedTables) {
+        for (uint32_t j = 0; j < TABLE_SIZE; j++) {
+            Page *page = directory[i]->pages[j];
+            if (page != nullptr)
+                hash ^= hashPage((i << TABLE_BITS) | j, page->data);
+        }
+    }
 
-    int numOfThreads = 16;  // Número de hilos. Con 16 va bien, y es un buen rendimiento entre
-                            // consumo de recursos y velocidad
+    return hash;
+}
 
+const uint8_t* Memory::refillRead(uint32_t page){
+    const uint8_t *data = blankPage();
 
-    uint32_t subSectionSize = iMemorySize / numOfThreads;
+    Page *found = findPage(directory, page);
+    if (found != nullptr)
+        data = found->data;
 
-    // Crear un vector para almacenar los hilos
-    std::vector<std::thread> hilos;
+    readTlb[page & (TLB_SIZE - 1)] = { page, data };
+    return data;
+}
+
+uint8_t* Memory::refillWrite(uint32_t page){
+    uint32_t dirIndex = page >> TABLE_BITS;
 
-    // Crear numOfThreads hilos, cada uno procesará un sexto del array
-    for (int i = 0; i < numOfThreads; ++i) {
-        uint32_t start = i * subSectionSize;
-        uint32_t end = (i + 1) * subSectionSize;
-        // Si es el último hilo, el rango final será el tamaño total del array
-        if (i == numOfThreads - 1) {
-            end = iMemorySize;
+    PageTable *&table = directory[dirIndex];
+    if (table == nullptr) {
+        table = new PageTable;
+        table->refs = 1;
+        for (uint32_t i = 0; i < TABLE_SIZE; i++)
+            table->pages[i] = nullptr;
+        usedTables.push_back(dirIndex);
+    } else if (table->refs > 1) {
+        // Tabla compartida con una instantánea: se copia
+        PageTable *copy = new PageTable;
+        copy->refs = 1;
+        for (uint32_t i = 0; i < TABLE_SIZE; i++) {
+            copy->pages[i] = table->pages[i];
+            if (copy->pages[i] != nullptr)
+                copy->pages[i]->refs++;
         }
-        // Crear el hilo y pasarle la función resetMemorySection y los parámetros de inicio y fin
-        hilos.emplace_back(&Memory::resetMemorySection, this, start, end);
+        unrefTable(table, &freePages);
+        table = copy;
     }
 
-    // Esperar a que todos los hilos terminen
-    for (auto& hilo : hilos) {
-        hilo.join();
+    Page *&entry = table->pages[page & (TABLE_SIZE - 1)];
+    if (entry == nullptr) {
+        entry = newPage();
+        std::memset(entry->data, RESET_VALUE, PAGE_SIZE);
+    } else if (entry->refs > 1) {
+        // Página compartida: se copia
+        Page *copy = newPage();
+        std::memcpy(copy->data, entry->data, PAGE_SIZE);
+        unrefPage(entry, &freePages);
+        entry = copy;
     }
 
-    this->resetIOMemory();
+    if (bTrackDirty)
+        vDirtyPages.push_back(page);
 
+    // La TLB de lectura podía tener la página en blanco o la compartida
+    writeTlb[page & (TLB_SIZE - 1)] = { page, entry->data };
+    readTlb[page & (TLB_SIZE - 1)] = { page, entry->data };
+    return entry->data;
 }
 
-// Función ejecutada por cada hilo
-void Memory::resetMemorySection(uint32_t inicio, uint32_t fin) {
-    // reset del array
-    for (uint32_t i = inicio; i < fin; ++i) {
-        this->memory[i] = 0xFF;
+void Memory::outOfRange(uint32_t addr, Fault kind){
+    if (fault == Fault::None) {
+        fault = kind;
+        iFaultAddr = addr;
     }
+    bWatchHit = true;
 }
 
-void Memory::resetIOMemory(){
-    for (uint32_t i = this->iMemorySize - this->pIo; i < this->iMemorySize; ++i) {
-        this->memory[i] = 0x20; // Caracter de espacio en utf8
+// Lee len bytes (2 o 4) en little-endian, uno a uno
+uint32_t Memory::readSplit(uint32_t addr, uint32_t len){
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < len; i++)
+        value |= static_cast<uint32_t>(pageForRead(addr + i)[(addr + i) & PAGE_MASK]) << (8 * i);
+    return value;
+}
+
+// Escribe los len bytes (2 o 4) más bajos de data en little-endian, uno a uno
+void Memory::writeSplit(uint32_t addr, uint32_t data, uint32_t len){
+    for (uint32_t i = 0; i < len; i++)
+        pageForWrite(addr + i)[(addr + i) & PAGE_MASK] = data >> (8 * i);
+}
+
+Memory::Page* Memory::newPage(){
+    Page *page;
+    if (freePages.empty()) {
+        page = new Page;
+    } else {
+        page = freePages.back();
+        freePages.pop_back();
     }
+
+    page->refs = 1;
+    return page;
+}
+
+Memory::Page* Memory::findPage(PageTable *const *dir, uint32_t page){
+    PageTable *table = dir[page >> TABLE_BITS];
+    if (table == nullptr)
+        return nullptr;
+    return table->pages[page & (TABLE_SIZE - 1)];
 }
 
+void Memory::unrefPage(Page *page, std::vector<Page*> *pool){
+    if (page->refs.fetch_sub(1) != 1)
+        return;
+
+    if (pool)
+        pool->push_back(page);
+    else
+        delete page;
+}
+
+void Memory::unrefTable(PageTable *table, std::vector<Page*> *pool){
+    if (table->refs.fetch_sub(1) != 1)
+        return;
+
+    for (uint32_t i = 0; i < TABLE_SIZE; i++) {
+        if (table->pages[i] != nullptr)
+            unrefPage(table->pages[i], pool);
+    }
+    delete table;
+}
+
+void Memory::releaseTables(){
+    for (uint32_t i : usedTables) {
+        unrefTable(directory[i], &freePages);
+        directory[i] = nullptr;
+    }
+    usedTables.clear();
+    vDirtyPages.clear();
+
+    flushTlb();
+}
+
+void Memory::flushTlb(){
+    for (uint32_t i = 0; i < TLB_SIZE; i++) {
+        readTlb[i] = { NO_PAGE, nullptr };
+        writeTlb[i] = { NO_PAGE, nullptr };
+    }
+}
+
+uint64_t MemorySnapshot::pageHash(uint32_t page) const{
+    Memory::Page *found = Memory::findPage(directory, page);
+    return found ? Memory::hashPage(page, found->data) : 0;
+}
+
+MemorySnapshot::~MemorySnapshot(){
+    for (uint32_t i : usedTables)
+        Memory::unrefTable(directory[i], nullptr);
+}
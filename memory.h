@@ -1,35 +1,295 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+/*
+    Memoria del emulador. El espacio de direcciones se divide en páginas de
+    4 KiB que se reservan la primera vez que se escriben, con una tabla de
+    páginas de dos niveles. Una página que nunca se ha escrito se lee como
+    recién reseteada (0xFF), así que el tamaño de la RAM de config.json no
+    cuesta memoria del host hasta que el programa la usa.
+
+    Para no recorrer la tabla en cada acceso hay dos TLB pequeñas (lectura y
+    escritura) con el puntero a las páginas usadas más recientemente.
+
+    reset() solo suelta las tablas que se han llegado a usar, así que cuesta
+    lo que ocupe el programa y no lo que mida la RAM. Las páginas liberadas
+    se guardan para reutilizarlas.
+
+    Las páginas y las tablas llevan un contador de referencias para poder
+    compartirlas con instantáneas (MemorySnapshot). Tomar una instantánea
+    solo comparte las tablas; la primera escritura en una página compartida
+    la copia (copy-on-write), y restaurarla vuelve a apuntar a las de la
+    instantánea sin tocar las páginas que no han cambiado.
+*/
+#include <atomic>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "endian.h"
+#include "icache.h"
+
+class MemorySnapshot;
 
 class Memory {
 public:
     Memory(uint32_t MEMORY_SIZE);
     ~Memory();
 
+    // Cada Memory es dueña de sus páginas
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+
     uint32_t iMemorySize;
     uint32_t iRomStartAddr;
     int iDataSize;
 
-    uint8_t *memory;
     uint32_t pIo = 1500; // 1500 son los caracteres que caben en la pantalla
 
-    void writeByte(uint32_t addr, int8_t data);
-    void writeHalf(uint32_t addr, int16_t data);
-    void writeWord(uint32_t addr, int32_t data);
+    // Caché de instrucciones de la CPU. Se invalida al escribir sobre código ya decodificado
+    InstructionCache *pICache = nullptr;
+
+    // Dirección vigilada (FINISH_LOCATION). Cuando una escritura la toca se activa
+    // bWatchHit, para que los núcleos paren justo después de esa instrucción
+    uint32_t iWatchAddr = 0xFFFFFFFF;
+    bool bWatchHit = false;
+
+    // Acceso fuera de la memoria. Se guarda el primero (tipo y dirección) y
+    // también se activa bWatchHit, así que los núcleos paran después de la
+    // instrucción igual que con la dirección vigilada. CPU::run lo convierte
+    // en una excepción
+    enum class Fault : uint8_t { None, Load, Store };
+    Fault fault = Fault::None;
+    uint32_t iFaultAddr = 0;
+
+    static const uint32_t PAGE_BITS = 12;
+    static const uint32_t PAGE_SIZE = 1 << PAGE_BITS;
+    static const uint32_t PAGE_MASK = PAGE_SIZE - 1;
+
+    // Valor de los bytes de una página sin escribir
+    static const uint8_t RESET_VALUE = 0xFF;
+
+    // La memoria guarda los datos en little-endian, igual que RISC-V, así que
+    // las medias palabras y las palabras (alineadas o no) se leen y escriben
+    // con un solo acceso del host. Solo los accesos que cruzan de una página
+    // a otra van byte a byte. Fuera de rango, las lecturas devuelven 0, las
+    // escrituras no hacen nada y las dos apuntan el fallo en fault
+
+    inline void writeByte(uint32_t addr, int8_t data){
+        if (addr >= iMemorySize) {
+            outOfRange(addr, Fault::Store);
+            return;
+        }
+
+        pageForWrite(addr)[addr & PAGE_MASK] = data;
+        written(addr, 1);
+    }
+    inline void writeHalf(uint32_t addr, int16_t data){
+        if (addr > iMemorySize - 2) {
+            outOfRange(addr, Fault::Store);
+            return;
+        }
+
+        if ((addr & PAGE_MASK) > PAGE_SIZE - 2) {
+            writeSplit(addr, static_cast<uint16_t>(data), 2);
+        } else {
+            uint16_t half = LittleHalf(data);
+            std::memcpy(pageForWrite(addr) + (addr & PAGE_MASK), &half, 2);
+        }
+        written(addr, 2);
+    }
+    inline void writeWord(uint32_t addr, int32_t data){
+        if (addr > iMemorySize - 4) {
+            outOfRange(addr, Fault::Store);
+            return;
+        }
+
+        if ((addr & PAGE_MASK) > PAGE_SIZE - 4) {
+            writeSplit(addr, data, 4);
+        } else {
+            uint32_t word = LittleWord(data);
+            std::memcpy(pageForWrite(addr) + (addr & PAGE_MASK), &word, 4);
+        }
+        written(addr, 4);
+    }
 
     // Lee un byte de memoria
-    uint8_t readByte(uint32_t addr);
+    inline uint8_t readByte(uint32_t addr){
+        if (addr >= iMemorySize) {
+            outOfRange(addr, Fault::Load);
+            return 0;
+        }
+
+        return pageForRead(addr)[addr & PAGE_MASK];
+    }
     // Lee 16 bits de la memoria y lo devuelve
-    uint16_t readHalf(uint32_t addr);
+    inline uint16_t readHalf(uint32_t addr){
+        if (addr > iMemorySize - 2) {
+            outOfRange(addr, Fault::Load);
+            return 0;
+        }
+
+        if ((addr & PAGE_MASK) > PAGE_SIZE - 2)
+            return readSplit(addr, 2);
+
+        uint16_t half;
+        std::memcpy(&half, pageForRead(addr) + (addr & PAGE_MASK), 2);
+        return LittleHalf(half);
+    }
     // Lee 32 bits de la memoria y lo devuelve como uint32_t
-    uint32_t readWord(uint32_t addr);
+    inline uint32_t readWord(uint32_t addr){
+        if (addr > iMemorySize - 4) {
+            outOfRange(addr, Fault::Load);
+            return 0;
+        }
+
+        if ((addr & PAGE_MASK) > PAGE_SIZE - 4)
+            return readSplit(addr, 4);
 
+        uint32_t word;
+        std::memcpy(&word, pageForRead(addr) + (addr & PAGE_MASK), 4);
+        return LittleWord(word);
+    }
+
+    // Deja la memoria como recién creada soltando todas las páginas escritas
     void reset();
-    void resetMemorySection(uint32_t inicio, uint32_t fin);
 
     void resetIOMemory();
+
+    // Guarda el contenido actual de la memoria. Las páginas se comparten con
+    // la instantánea hasta que se vuelven a escribir
+    std::shared_ptr<const MemorySnapshot> snapshot();
+
+    // Vuelve al contenido de una instantánea tomada de una memoria del mismo
+    // tamaño. Solo invalida la caché de instrucciones en las páginas que cambian
+    void restore(const MemorySnapshot &snap);
+
+    // Páginas escritas desde la última llamada a clearDirty(), para mantener
+    // un hash del contenido sin recorrer toda la memoria (ver statehash.h).
+    // Solo se apuntan con bTrackDirty, y una página puede salir repetida
+    bool bTrackDirty = false;
+    std::vector<uint32_t>& dirtyPages() { return vDirtyPages; }
+    void clearDirty();
+
+    // Hash del contenido de una página, o de toda la memoria como XOR de
+    // todas las páginas. Una página como recién reseteada da 0, esté
+    // reservada o no
+    uint64_t pageHash(uint32_t page);
+    uint64_t contentHash();
+    static uint64_t hashPage(uint32_t page, const uint8_t *data);
+
+private:
+    friend class MemorySnapshot;
+
+    // Tabla de páginas: el primer nivel usa los 10 bits altos de la dirección
+    // y el segundo los 10 siguientes
+    static const uint32_t TABLE_BITS = 10;
+    static const uint32_t TABLE_SIZE = 1 << TABLE_BITS;
+    static const uint32_t DIRECTORY_SIZE = 1 << (32 - PAGE_BITS - TABLE_BITS);
+
+    struct Page {
+        std::atomic<uint32_t> refs;
+        uint8_t data[PAGE_SIZE];
+    };
+    struct PageTable {
+        std::atomic<uint32_t> refs;
+        Page *pages[TABLE_SIZE];
+    };
+
+    PageTable *directory[DIRECTORY_SIZE];
+    std::vector<uint32_t> usedTables;   // Entradas del directorio con tabla
+    std::vector<Page*> freePages;       // Páginas liberadas para reutilizar
+    std::vector<uint32_t> vDirtyPages;  // Ver dirtyPages()
+
+    // TLB de correspondencia directa, indexadas por el número de página.
+    // La de lectura puede apuntar a la página en blanco compartida
+    static const uint32_t TLB_SIZE = 64;
+    static const uint32_t NO_PAGE = 0xFFFFFFFF;
+
+    struct ReadEntry {
+        uint32_t page;
+        const uint8_t *data;
+    };
+    struct WriteEntry {
+        uint32_t page;
+        uint8_t *data;
+    };
+
+    ReadEntry readTlb[TLB_SIZE];
+    WriteEntry writeTlb[TLB_SIZE];
+
+    inline const uint8_t* pageForRead(uint32_t addr){
+        uint32_t page = addr >> PAGE_BITS;
+        const ReadEntry &entry = readTlb[page & (TLB_SIZE - 1)];
+        if (entry.page == page)
+            return entry.data;
+        return refillRead(page);
+    }
+    inline uint8_t* pageForWrite(uint32_t addr){
+        uint32_t page = addr >> PAGE_BITS;
+        const WriteEntry &entry = writeTlb[page & (TLB_SIZE - 1)];
+        if (entry.page == page)
+            return entry.data;
+        return refillWrite(page);
+    }
+
+    // Buscan la página en la tabla y la guardan en la TLB. Para escribir,
+    // la reservan si todavía no existe y copian la tabla y la página si
+    // están compartidas. La TLB de escritura solo guarda páginas propias, y
+    // se vacía al tomar una instantánea
+    const uint8_t* refillRead(uint32_t page);
+    uint8_t* refillWrite(uint32_t page);
+
+    // Apunta un acceso fuera de rango. No está en línea para no engordar
+    // los accesos normales
+    void outOfRange(uint32_t addr, Fault kind);
+
+    // Accesos que cruzan el límite de una página
+    uint32_t readSplit(uint32_t addr, uint32_t len);
+    void writeSplit(uint32_t addr, uint32_t data, uint32_t len);
+
+    Page* newPage();
+    static Page* findPage(PageTable *const *dir, uint32_t page);
+
+    // Quitan una referencia y liberan lo que se queda sin ninguna. Las
+    // páginas van a pool si no es nullptr
+    static void unrefPage(Page *page, std::vector<Page*> *pool);
+    static void unrefTable(PageTable *table, std::vector<Page*> *pool);
+
+    // Suelta todas las tablas y vacía las TLB
+    void releaseTables();
+    void flushTlb();
+
+    // Después de escribir len bytes en addr: invalida el código decodificado
+    // que se haya pisado y comprueba la dirección vigilada
+    inline void written(uint32_t addr, uint32_t len){
+        if (pICache)
+            pICache->invalidate(addr, len);
+
+        if (iWatchAddr - addr < len)
+            bWatchHit = true;
+    }
+};
+
+// Contenido de una Memory en un momento dado. Se crea con Memory::snapshot()
+// y se puede restaurar tantas veces como se quiera
+class MemorySnapshot {
+public:
+    ~MemorySnapshot();
+
+    MemorySnapshot(const MemorySnapshot&) = delete;
+    MemorySnapshot& operator=(const MemorySnapshot&) = delete;
+
+    // Igual que Memory::pageHash(), con el contenido de la instantánea
+    uint64_t pageHash(uint32_t page) const;
+
+private:
+    friend class Memory;
+    MemorySnapshot() = default;
+
+    uint32_t iMemorySize;
+    Memory::PageTable *directory[Memory::DIRECTORY_SIZE];
+    std::vector<uint32_t> usedTables;
 };
 
 #endif // MEMORY_H
@@ -0,0 +1,201 @@
+#include "shards.h"
+#include "atomicfile.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char *const MAGIC = "kronos-shard";
+
+ShardRange shardRange(uint32_t total, uint32_t shard, uint32_t shardCount){
+    ShardRange range;
+    range.begin = static_cast<uint64_t>(total) * shard / shardCount;
+    range.end = static_cast<uint64_t>(total) * (shard + 1) / shardCount;
+    return range;
+}
+
+// FNV-1a de 64 bits
+static void hashBytes(uint64_t &hash, const void *data, size_t size){
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+}
+
+static void hashInt(uint64_t &hash, int32_t value){
+    uint8_t bytes[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+    hashBytes(hash, bytes, sizeof(bytes));
+}
+
+// Contenido del programa, para que un binario recompilado en la misma ruta
+// no se junte con los trozos del anterior. Si no se puede leer se usa la
+// ruta, y la campaña fallará igualmente al cargarlo
+static void hashProgram(uint64_t &hash, const std::string &path){
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        hashBytes(hash, path.data(), path.size());
+        return;
+    }
+
+    uint64_t size = 0;
+    char buffer[64 * 1024];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        hashBytes(hash, buffer, file.gcount());
+        size += file.gcount();
+    }
+    hashInt(hash, static_cast<int32_t>(size));
+}
+
+uint64_t campaignId(const Campaign &campaign){
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    hashProgram(hash, campaign.programPath);
+    hashInt(hash, campaign.expectedResult);
+    hashInt(hash, static_cast<int32_t>(campaign.expectedInstructions));
+
+    hashInt(hash, campaign.injections.size());
+    for (const Injection &injection : campaign.injections) {
+        hashInt(hash, injection.cycle);
+        hashInt(hash, injection.reg);
+        hashInt(hash, injection.bit);
+    }
+
+    return hash;
+}
+
+static std::string shardName(const std::string &workDir, uint32_t shard, uint32_t shardCount, const char *extension){
+    char name[64];
+    std::snprintf(name, sizeof(name), "shard-%04u-of-%04u.%s", shard, shardCount, extension);
+    return workDir.empty() ? std::string(name) : workDir + "/" + name;
+}
+
+std::string shardResultFile(const std::string &workDir, uint32_t shard, uint32_t shardCount){
+    return shardName(workDir, shard, shardCount, "result");
+}
+
+std::string shardLockFile(const std::string &workDir, uint32_t shard, uint32_t shardCount){
+    return shardName(workDir, shard, shardCount, "lock");
+}
+
+bool claimShard(const std::string &workDir, uint32_t shard, uint32_t shardCount){
+    // "x": falla si el archivo ya existe, también en un sistema de archivos compartido
+    std::FILE *file = std::fopen(shardLockFile(workDir, shard, shardCount).c_str(), "wx");
+    if (file == nullptr)
+        return false;
+
+    std::fclose(file);
+    return true;
+}
+
+int writeShardResult(const std::string &filename, const ShardResult &result){
+    // Se escribe aparte y se renombra, para que --merge no lea un trozo a
+    // medias aunque otro proceso lo esté repitiendo
+    std::string temp = tempFileName(filename);
+
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Error al crear el archivo: " << temp << std::endl;
+            return 1;
+        }
+
+        file << MAGIC << " " << result.shard << " " << result.shardCount << " "
+             << result.begin << " " << result.end << " " << result.total << " "
+             << std::hex << result.campaignId << std::dec << "\n";
+
+        // Un dígito (CampaignResult) por inyección. Un trozo vacío deja la
+        // línea vacía: el número de inyecciones ya está en la cabecera
+        std::string line(result.results.size(), '0');
+        for (size_t i = 0; i < result.results.size(); i++)
+            line[i] = static_cast<char>('0' + result.results[i]);
+        file << line << "\n";
+
+        if (!file.good()) {
+            file.close();
+            std::remove(temp.c_str());
+            std::cerr << "Error al escribir el archivo: " << temp << std::endl;
+            return 1;
+        }
+    }
+
+    if (replaceFile(temp, filename) != 0) {
+        std::cerr << "Error al renombrar " << temp << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int readShardResult(const std::string &filename, ShardResult &result){
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return 1;
+
+    std::string magic, rest, line;
+    file >> magic >> result.shard >> result.shardCount >> result.begin >> result.end >> result.total
+         >> std::hex >> result.campaignId >> std::dec;
+
+    // Resto de la cabecera y línea de resultados, que puede estar vacía
+    std::getline(file, rest);
+    std::getline(file, line);
+
+    if (!file || !rest.empty() || magic != MAGIC || result.begin > result.end || result.end > result.total
+        || line.size() != result.end - result.begin) {
+        std::cerr << "Archivo de resultados no válido: " << filename << std::endl;
+        return 1;
+    }
+
+    result.results.resize(line.size());
+    for (size_t i = 0; i < line.size(); i++) {
+        if (line[i] < '0' || line[i] > '3') {
+            std::cerr << "Archivo de resultados no válido: " << filename << std::endl;
+            return 1;
+        }
+        result.results[i] = line[i] - '0';
+    }
+
+    return 0;
+}
+
+int mergeShards(const std::string &workDir, uint32_t shardCount, std::vector<uint8_t> &results,
+                std::vector<uint32_t> *missing){
+    results.clear();
+    if (missing)
+        missing->clear();
+
+    bool bFirst = true;
+    uint32_t total = 0;
+    uint64_t id = 0;
+    int error = 0;
+
+    for (uint32_t shard = 0; shard < shardCount; shard++) {
+        ShardResult result;
+        if (readShardResult(shardResultFile(workDir, shard, shardCount), result) != 0) {
+            if (missing)
+                missing->push_back(shard);
+            error = 1;
+            continue;
+        }
+
+        if (bFirst) {
+            total = result.total;
+            id = result.campaignId;
+            results.resize(total);
+            bFirst = false;
+        }
+
+        // Todos los trozos tienen que ser de la misma campaña y del mismo reparto
+        ShardRange range = shardRange(total, shard, shardCount);
+        if (result.total != total || result.campaignId != id || result.shard != shard
+            || result.shardCount != shardCount || result.begin != range.begin || result.end != range.end) {
+            std::cerr << "El trozo " << shard << " no es de la misma campaña" << std::endl;
+            return 1;
+        }
+
+        std::copy(result.results.begin(), result.results.end(), results.begin() + range.begin);
+    }
+
+    return error;
+}
@@ -0,0 +1,66 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+/*
+    Reparto de una campaña en trozos (shards) que se ejecutan en procesos
+    distintos, en esta máquina o en otras que compartan un directorio de
+    trabajo.
+
+    El trozo k de n son siempre las mismas inyecciones, [total * k / n,
+    total * (k + 1) / n), así que repetir un trozo que ha fallado da los
+    mismos resultados. Cada trozo deja sus resultados en su propio archivo
+    del directorio de trabajo, y al final se juntan en el orden de la
+    campaña.
+
+    Para repartirse los trozos, cada proceso crea en exclusiva el archivo
+    .lock del trozo antes de ejecutarlo. Si un trozo falla, basta con
+    borrar su .lock para que lo coja otro proceso, o ejecutarlo a mano.
+*/
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "computer.h"
+
+struct ShardRange {
+    uint32_t begin;
+    uint32_t end;
+};
+
+struct ShardResult {
+    uint32_t shard = 0;
+    uint32_t shardCount = 0;
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    uint32_t total = 0;                 // Inyecciones de la campaña completa
+    uint64_t campaignId = 0;            // Ver campaignId()
+    std::vector<uint8_t> results;       // CampaignResult de [begin, end)
+};
+
+// Inyecciones del trozo shard de shardCount
+ShardRange shardRange(uint32_t total, uint32_t shard, uint32_t shardCount);
+
+// Huella de la campaña (contenido del programa, valores esperados e
+// inyecciones), para no juntar trozos de campañas distintas
+uint64_t campaignId(const Campaign &campaign);
+
+// Nombres de los archivos del trozo en el directorio de trabajo
+std::string shardResultFile(const std::string &workDir, uint32_t shard, uint32_t shardCount);
+std::string shardLockFile(const std::string &workDir, uint32_t shard, uint32_t shardCount);
+
+// Crea el .lock del trozo si no existe. Devuelve false si ya lo tiene otro
+bool claimShard(const std::string &workDir, uint32_t shard, uint32_t shardCount);
+
+// Escribe los resultados de un trozo. Se escriben en un temporal y se
+// renombra, para que nunca se lea un archivo a medias. Devuelve 1 si falla
+int writeShardResult(const std::string &filename, const ShardResult &result);
+
+// Devuelve 1 si no existe o no es válido
+int readShardResult(const std::string &filename, ShardResult &result);
+
+// Junta los shardCount trozos de workDir en results, en el orden de la
+// campaña. Devuelve 1 si falta alguno o no son de la misma campaña, con
+// los que faltan en missing
+int mergeShards(const std::string &workDir, uint32_t shardCount, std::vector<uint8_t> &results,
+                std::vector<uint32_t> *missing = nullptr);
+
+#endif // SHARDS_H
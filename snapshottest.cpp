@@ -0,0 +1,131 @@
+/*
+    Prueba de las instantáneas de la memoria (Memory::snapshot/restore).
+
+    Con cada núcleo:
+    - Restaurar una instantánea tomada a mitad de la ejecución y seguir da
+      el mismo estado final que la ejecución sin interrumpir, aunque la
+      memoria se haya modificado después de tomarla (copia en escritura).
+    - Si después de la instantánea se modifica el código, la ejecución
+      cambia (las escrituras invalidan la caché de instrucciones), y al
+      restaurar se vuelve al código original: restore() tiene que invalidar
+      lo que ya estaba decodificado de las páginas que cambian.
+
+    Los registros se guardan y se restauran como en Computer::snapshot().
+*/
+#include "testprogram.h"
+#include <memory>
+
+static const uint32_t SNAPSHOT_CYCLE = 500;
+static const uint32_t DATA_LAST = TEST_DATA_ADDR + 4 * 63;    // Palabra de la última vuelta del bucle
+
+struct Snapshot {
+    reg registers[32];
+    uint32_t pc;
+    uint32_t cycles;
+    std::shared_ptr<const MemorySnapshot> ram;
+};
+
+static Snapshot snapshot(Memory &ram, CPU &cpu){
+    Snapshot snap;
+    for (int i = 0; i < 32; i++)
+        snap.registers[i] = cpu.registers[i];
+    snap.pc = cpu.pc;
+    snap.cycles = cpu.cycles;
+    snap.ram = ram.snapshot();
+    return snap;
+}
+
+static void restore(Memory &ram, CPU &cpu, const Snapshot &snap){
+    cpu.reset();
+    for (int i = 0; i < 32; i++)
+        cpu.registers[i] = snap.registers[i];
+    cpu.pc = snap.pc;
+    cpu.cycles = snap.cycles;
+    ram.restore(*snap.ram);
+}
+
+struct FinalState {
+    reg registers[32];
+    uint32_t cycles;
+    uint64_t memory;
+};
+
+static FinalState finalState(Memory &ram, CPU &cpu){
+    FinalState state;
+    for (int i = 0; i < 32; i++)
+        state.registers[i] = cpu.registers[i];
+    state.cycles = cpu.cycles;
+    state.memory = memoryHash(ram);
+    return state;
+}
+
+static bool operator==(const FinalState &a, const FinalState &b){
+    for (int i = 0; i < 32; i++) {
+        if (a.registers[i] != b.registers[i])
+            return false;
+    }
+    return a.cycles == b.cycles && a.memory == b.memory;
+}
+
+static void testCore(CPU::Core core, const std::string &name){
+    Memory ram(TEST_MEMORY_SIZE);
+    std::unique_ptr<CPU> cpu(new CPU(&ram));
+    cpu->core = core;
+    loadTest(ram, *cpu, testProgram());
+
+    // Ejecución de referencia, con una instantánea a mitad
+    check(!runTest(ram, *cpu, SNAPSHOT_CYCLE, SNAPSHOT_CYCLE), name + ": termina antes de la instantánea");
+    Snapshot snap = snapshot(ram, *cpu);
+    uint32_t dataWord = ram.readWord(DATA_LAST);
+
+    check(runTest(ram, *cpu, 64), name + ": la ejecución de referencia no termina");
+    FinalState reference = finalState(ram, *cpu);
+    check(ram.readWord(DATA_LAST) != dataWord, name + ": el programa no modifica los datos");
+
+    // Restaurar devuelve la memoria de la instantánea, aunque se haya
+    // escrito después, y la ejecución acaba igual
+    restore(ram, *cpu, snap);
+    check(ram.readWord(DATA_LAST) == dataWord, name + ": restore no devuelve la memoria");
+    check(runTest(ram, *cpu, 64), name + ": no termina después de restaurar");
+    check(finalState(ram, *cpu) == reference, name + ": el estado final después de restaurar es distinto");
+
+    // La instantánea no cambia al escribir en la memoria restaurada
+    restore(ram, *cpu, snap);
+    ram.writeWord(DATA_LAST, ~dataWord);
+    restore(ram, *cpu, snap);
+    check(ram.readWord(DATA_LAST) == dataWord, name + ": una escritura cambia la instantánea");
+
+    // Código modificado después de la instantánea: addi s1, s1, 1 en lugar
+    // de xori s1, s1, 0x5a5. La instrucción ya está decodificada
+    uint32_t patchAddr = TEST_ROM_START + 4 * TEST_PATCH_INDEX;
+    uint32_t patch = encodeI(1, S1, 0, S1, 0x13);
+    check(cpu->icache.lookup(patchAddr)->valid, name + ": la instrucción modificada no se ha ejecutado");
+
+    restore(ram, *cpu, snap);
+    for (int i = 0; i < 4; i++)
+        ram.writeByte(patchAddr + i, patch >> (8 * i));
+    check(!cpu->icache.lookup(patchAddr)->valid, name + ": la escritura no invalida la caché de instrucciones");
+    check(runTest(ram, *cpu, 64), name + ": no termina con el código modificado");
+    check(!(finalState(ram, *cpu) == reference), name + ": el código modificado no cambia la ejecución");
+
+    // Al restaurar vuelve el código original, y lo decodificado del
+    // modificado no se puede seguir usando
+    check(cpu->icache.lookup(patchAddr)->valid, name + ": el código modificado no se ha ejecutado");
+    restore(ram, *cpu, snap);
+    check(!cpu->icache.lookup(patchAddr)->valid, name + ": restore no invalida la caché de instrucciones");
+    check(runTest(ram, *cpu, 64), name + ": no termina después de deshacer el cambio");
+    check(finalState(ram, *cpu) == reference, name + ": restore no deshace el cambio en el código");
+
+    ram.pICache = nullptr;
+}
+
+int main(){
+    for (const auto &core : TEST_CORES)
+        testCore(core.core, core.name);
+
+    if (testFailures > 0)
+        return 1;
+
+    std::cout << "Instantáneas: correcto" << std::endl;
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "statehash.h"
+#include <algorithm>
+
+void StateHasher::start(Computer &computer, const MemorySnapshot &base, uint64_t memoryHash){
+    pBase = &base;
+    iMemoryHash = memoryHash;
+    pageHashes.clear();
+
+    computer.ram.clearDirty();
+    computer.ram.bTrackDirty = true;
+}
+
+void StateHasher::stop(Computer &computer){
+    computer.ram.bTrackDirty = false;
+    computer.ram.clearDirty();
+    pBase = nullptr;
+}
+
+uint64_t StateHasher::registersHash(const CPU &cpu){
+    uint64_t hash = cpu.pc * 0xC2B2AE3D27D4EB4Full;
+    for (int i = 0; i < 32; i++) {
+        hash ^= static_cast<uint32_t>(cpu.registers[i]);
+        hash = ((hash << 27) | (hash >> 37)) * 0x9E3779B97F4A7C15ull;
+    }
+    return hash;
+}
+
+uint64_t StateHasher::memoryHash(Computer &computer){
+    std::vector<uint32_t> &dirty = computer.ram.dirtyPages();
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    // Se quita el hash que tenía cada página y se pone el nuevo
+    for (uint32_t page : dirty) {
+        uint64_t current = computer.ram.pageHash(page);
+
+        auto it = pageHashes.find(page);
+        if (it == pageHashes.end()) {
+            iMemoryHash ^= pBase->pageHash(page) ^ current;
+            pageHashes.emplace(page, current);
+        } else {
+            iMemoryHash ^= it->second ^ current;
+            it->second = current;
+        }
+    }
+    computer.ram.clearDirty();
+
+    return iMemoryHash;
+}
+
+bool StateHasher::matches(Computer &computer, const StateHash &reference){
+    if (registersHash(computer.cpu) != reference.registers) {
+        // Las páginas se quedan para la siguiente vez, pero sin repetir
+        // para que la lista no crezca con cada fallo de la TLB
+        std::vector<uint32_t> &dirty = computer.ram.dirtyPages();
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        return false;
+    }
+
+    return memoryHash(computer) == reference.memory;
+}
@@ -0,0 +1,55 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+/*
+    Hash del estado del ordenador (registros, PC y memoria) para comparar
+    una ejecución con inyección con la de referencia en el mismo ciclo. Si
+    coinciden, el error ya se ha enmascarado y el resto de la ejecución será
+    igual, así que se puede dar por NO_EFFECT sin terminarla.
+
+    El hash de la memoria es el XOR del hash de cada página (Memory::pageHash),
+    así que no hace falta recorrerla entera: se parte del hash de una
+    instantánea y solo se vuelven a calcular las páginas escritas desde
+    entonces (Memory::dirtyPages). Los registros se comparan antes, porque
+    es mucho más barato y casi siempre basta para ver que no coinciden.
+*/
+#include <cstdint>
+#include <unordered_map>
+#include "computer.h"
+
+struct StateHash {
+    uint64_t registers;
+    uint64_t memory;
+
+    bool operator==(const StateHash &other) const { return registers == other.registers && memory == other.memory; }
+};
+
+class StateHasher {
+public:
+    // Empieza a seguir computer, cuya memoria tiene que ser la de base, con
+    // hash memoryHash (Memory::contentHash() o uno guardado antes)
+    void start(Computer &computer, const MemorySnapshot &base, uint64_t memoryHash);
+
+    // Deja de apuntar las páginas escritas
+    void stop(Computer &computer);
+
+    // Hash de los registros y el PC
+    static uint64_t registersHash(const CPU &cpu);
+
+    // Hash de la memoria. Solo recalcula las páginas escritas desde la
+    // llamada anterior
+    uint64_t memoryHash(Computer &computer);
+
+    StateHash hash(Computer &computer) { return { registersHash(computer.cpu), memoryHash(computer) }; }
+
+    // Si el estado de computer es el de reference. La memoria solo se mira
+    // si coinciden los registros
+    bool matches(Computer &computer, const StateHash &reference);
+
+private:
+    const MemorySnapshot *pBase = nullptr;
+    uint64_t iMemoryHash = 0;
+    std::unordered_map<uint32_t, uint64_t> pageHashes;  // Páginas ya recalculadas
+};
+
+#endif // STATEHASH_H
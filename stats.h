@@ -0,0 +1,65 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+    Políticas de recogida de estadísticas de ejecución. Los bucles de los
+    núcleos del intérprete son plantillas sobre una de estas políticas, así
+    que con StatsNone el contador desaparece del código generado.
+
+    Cada nivel incluye lo de los anteriores:
+        - StatsNone:      nada
+        - StatsPerType:   CPU::ciclosTipo (instrucciones por formato)
+        - StatsPerOpcode: además CPU::ciclosTotales (por operación)
+        - StatsPerPc:     además CPU::ciclosPc (por dirección de la ROM)
+*/
+#include <cstdint>
+#include "decoder.h"
+
+enum class StatsLevel { None, PerType, PerOpcode, PerPc };
+
+struct StatsNone {
+    template <class C>
+    static inline void count(C &, uint32_t, uint8_t, uint8_t) {}
+};
+
+struct StatsPerType {
+    template <class C>
+    static inline void count(C &cpu, uint32_t, uint8_t op, uint8_t tipo) {
+        if (op != Operation::NOP)
+            cpu.ciclosTipo[tipo]++;
+    }
+};
+
+struct StatsPerOpcode {
+    template <class C>
+    static inline void count(C &cpu, uint32_t pc, uint8_t op, uint8_t tipo) {
+        StatsPerType::count(cpu, pc, op, tipo);
+        cpu.ciclosTotales[op]++;
+    }
+};
+
+struct StatsPerPc {
+    template <class C>
+    static inline void count(C &cpu, uint32_t pc, uint8_t op, uint8_t tipo) {
+        StatsPerOpcode::count(cpu, pc, op, tipo);
+
+        uint32_t index = (pc - cpu.icache.iStart) >> 2;
+        if (index < cpu.ciclosPc.size())
+            cpu.ciclosPc[index]++;
+    }
+};
+
+// Llama a f con la política que corresponde a level. Así la elección se hace
+// una sola vez por ráfaga y no en cada instrucción
+template <class F>
+inline auto dispatchStats(StatsLevel level, F &&f) {
+    switch (level)
+    {
+    case StatsLevel::None:    return f(StatsNone());
+    case StatsLevel::PerType: return f(StatsPerType());
+    case StatsLevel::PerPc:   return f(StatsPerPc());
+    default:                  return f(StatsPerOpcode());
+    }
+}
+
+#endif // STATS_H
@@ -0,0 +1,168 @@
+#ifndef TESTPROGRAM_H
+#define TESTPROGRAM_H
+
+/*
+    Utilidades comunes de las pruebas (*test.cpp, se ejecutan con ctest).
+
+    Un programa fijo que termina solo, con cargas y escrituras de todos los
+    tamaños, saltos condicionales, llamadas con JAL/JALR, desplazamientos,
+    AUIPC y LUI, y una memoria y una CPU configuradas para ejecutarlo. El
+    programa deja el resultado en TEST_RESULT_ADDR y escribe un 0 en
+    TEST_FINISH_ADDR al terminar.
+*/
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "cpu.h"
+#include "memory.h"
+
+static const uint32_t TEST_MEMORY_SIZE = 0x100000;
+static const uint32_t TEST_ROM_START = 0x1000;
+static const uint32_t TEST_RESULT_ADDR = 0x8000;
+static const uint32_t TEST_FINISH_ADDR = 0x8004;
+static const uint32_t TEST_DATA_ADDR = 0x10000;
+static const uint32_t TEST_LIMIT = 1000000;
+
+// Posición en el programa de la instrucción que modifican las pruebas de
+// código automodificado (xori s1, s1, 0x5a5)
+static const uint32_t TEST_PATCH_INDEX = 33;
+
+// Codificación de las instrucciones
+static inline uint32_t encodeR(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd){
+    return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | 0x33;
+}
+static inline uint32_t encodeI(int32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode){
+    return (uint32_t)(imm & 0xFFF) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+static inline uint32_t encodeS(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3){
+    return (uint32_t)((imm >> 5) & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (uint32_t)(imm & 0x1F) << 7 | 0x23;
+}
+static inline uint32_t encodeB(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3){
+    return (uint32_t)((imm >> 12) & 0x1) << 31 | (uint32_t)((imm >> 5) & 0x3F) << 25 | rs2 << 20 | rs1 << 15
+           | funct3 << 12 | (uint32_t)((imm >> 1) & 0xF) << 8 | (uint32_t)((imm >> 11) & 0x1) << 7 | 0x63;
+}
+static inline uint32_t encodeU(uint32_t imm, uint32_t rd, uint32_t opcode){
+    return imm << 12 | rd << 7 | opcode;
+}
+static inline uint32_t encodeJ(int32_t imm, uint32_t rd){
+    return (uint32_t)((imm >> 20) & 0x1) << 31 | (uint32_t)((imm >> 1) & 0x3FF) << 21 | (uint32_t)((imm >> 11) & 0x1) << 20
+           | (uint32_t)((imm >> 12) & 0xFF) << 12 | rd << 7 | 0x6F;
+}
+
+// Registros que usa el programa
+enum : uint32_t { ZERO = 0, RA = 1, T0 = 5, T1 = 6, T2 = 7, S0 = 8, S1 = 9, A0 = 10, A1 = 11, A2 = 12,
+                  A4 = 14, A5 = 15, A6 = 16, A7 = 17, S2 = 18, T3 = 28, T4 = 29, T5 = 30, T6 = 31 };
+
+// 64 vueltas de un bucle que escribe, lee y mezcla una tabla en
+// TEST_DATA_ADDR, con una llamada a una función en cada vuelta
+static inline std::vector<uint32_t> testProgram(){
+    return {
+        encodeU(0x8, S0, 0x37),                 //  0       lui  s0, 0x8
+        encodeU(0x10, S2, 0x37),                //  1       lui  s2, 0x10
+        encodeI(7, ZERO, 0, S1, 0x13),          //  2       addi s1, zero, 7
+        encodeI(0, ZERO, 0, T0, 0x13),          //  3       addi t0, zero, 0
+        encodeI(64, ZERO, 0, T1, 0x13),         //  4       addi t1, zero, 64
+        encodeI(2, T0, 1, T2, 0x13),            //  5 loop: slli t2, t0, 2
+        encodeR(0, T2, S2, 0, T3),              //  6       add  t3, s2, t2
+        encodeR(0, S1, T0, 4, T4),              //  7       xor  t4, t0, s1
+        encodeS(0, T4, T3, 2),                  //  8       sw   t4, 0(t3)
+        encodeI(0, T3, 2, T5, 0x03),            //  9       lw   t5, 0(t3)
+        encodeR(0, T5, S1, 0, S1),              // 10       add  s1, s1, t5
+        encodeI(3, S1, 5, T6, 0x13),            // 11       srli t6, s1, 3
+        encodeR(0, T6, S1, 4, S1),              // 12       xor  s1, s1, t6
+        encodeS(2, S1, T3, 1),                  // 13       sh   s1, 2(t3)
+        encodeI(2, T3, 5, A0, 0x03),            // 14       lhu  a0, 2(t3)
+        encodeI(3, T3, 0, A1, 0x03),            // 15       lb   a1, 3(t3)
+        encodeR(0, A0, S1, 0, S1),              // 16       add  s1, s1, a0
+        encodeR(0x20, A1, S1, 0, S1),           // 17       sub  s1, s1, a1
+        encodeJ(24, RA),                        // 18       jal  ra, func
+        encodeI(1, T0, 0, T0, 0x13),            // 19       addi t0, t0, 1
+        encodeB(-60, T1, T0, 4),                // 20       blt  t0, t1, loop
+        encodeS(0, S1, S0, 0),                  // 21       sb   s1, 0(s0)
+        encodeS(4, ZERO, S0, 0),                // 22       sb   zero, 4(s0)
+        encodeJ(0, ZERO),                       // 23 spin: jal  zero, spin
+        encodeI(31, T0, 7, A4, 0x13),           // 24 func: andi a4, t0, 31
+        encodeR(0, A4, S1, 1, A5),              // 25       sll  a5, s1, a4
+        encodeI(0x400 | 5, S1, 5, A6, 0x13),    // 26       srai a6, s1, 5
+        encodeR(0, A6, A5, 4, S1),              // 27       xor  s1, a5, a6
+        encodeR(0, ZERO, S1, 2, A2),            // 28       slt  a2, s1, zero
+        encodeR(0, A2, S1, 0, S1),              // 29       add  s1, s1, a2
+        encodeU(0, A7, 0x17),                   // 30       auipc a7, 0
+        encodeR(0, A7, S1, 0, S1),              // 31       add  s1, s1, a7
+        encodeB(8, ZERO, S1, 5),                // 32       bge  s1, zero, skip
+        encodeI(0x5A5, S1, 4, S1, 0x13),        // 33       xori s1, s1, 0x5a5
+        encodeI(0, RA, 0, ZERO, 0x67),          // 34 skip: jalr zero, 0(ra)
+    };
+}
+
+// Escribe program en filename, en little endian. Devuelve 1 si no se puede
+static inline int writeProgram(const std::string &filename, const std::vector<uint32_t> &program){
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    for (uint32_t word : program) {
+        char bytes[4] = { char(word), char(word >> 8), char(word >> 16), char(word >> 24) };
+        file.write(bytes, sizeof(bytes));
+    }
+    return file.good() ? 0 : 1;
+}
+
+// Resetea ram y cpu (que tiene que usar ram) y carga program en TEST_ROM_START
+static inline void loadTest(Memory &ram, CPU &cpu, const std::vector<uint32_t> &program){
+    ram.iRomStartAddr = TEST_ROM_START;
+    ram.pICache = &cpu.icache;
+    ram.reset();
+    cpu.reset();
+
+    // Byte a byte y en little endian, como los binarios que carga LoadProgram
+    uint32_t addr = TEST_ROM_START;
+    for (uint32_t word : program) {
+        for (int i = 0; i < 4; i++)
+            ram.writeByte(addr++, word >> (8 * i));
+    }
+    cpu.icache.setRegion(TEST_ROM_START, addr - TEST_ROM_START);
+}
+
+// Ejecuta en ráfagas de burst instrucciones hasta que el programa termina o
+// llega a limit instrucciones. Devuelve si ha terminado
+static inline bool runTest(Memory &ram, CPU &cpu, uint32_t burst, uint32_t limit = TEST_LIMIT){
+    ram.iWatchAddr = TEST_FINISH_ADDR;
+
+    while (cpu.cycles < limit) {
+        uint32_t n = limit - cpu.cycles;
+        if (cpu.runInstructions(n < burst ? n : burst) == 0)
+            return false;
+        if (ram.bWatchHit && ram.readByte(TEST_FINISH_ADDR) == 0)
+            return true;
+    }
+    return false;
+}
+
+// FNV-1a de toda la memoria, para comparar su contenido
+static inline uint64_t memoryHash(Memory &ram){
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (uint32_t addr = 0; addr < ram.iMemorySize; addr++) {
+        hash ^= ram.readByte(addr);
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static const struct { CPU::Core core; const char *name; } TEST_CORES[] = {
+    { CPU::Core::Classic,  "classic" },
+    { CPU::Core::Threaded, "threaded" },
+    { CPU::Core::Block,    "block" },
+    { CPU::Core::Jit,      "jit" },
+};
+
+// Apunta un fallo si no se cumple ok
+static int testFailures = 0;
+
+static inline void check(bool ok, const std::string &what){
+    if (!ok) {
+        std::cerr << "FALLO: " << what << std::endl;
+        testFailures++;
+    }
+}
+
+#endif // TESTPROGRAM_H
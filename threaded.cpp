@@ -0,0 +1,200 @@
+/*
+    NÚCLEO "THREADED" DEL INTÉRPRETE.
+
+    En vez de buscar la función de cada instrucción en vFunctionMap y
+    llamarla, cada instrucción salta directamente al código de la
+    siguiente a través de una tabla de etiquetas indexada por Operation
+    (computed goto). El PC y los ciclos se mantienen en variables locales
+    y los operandos se leen directamente de la caché de predecodificación.
+
+    La semántica de cada instrucción es la misma que la de su función en
+    cpu.cpp. No se genera desensamblado.
+
+    Si una escritura toca la dirección vigilada (ram->iWatchAddr) o un
+    acceso se sale de la memoria se para justo después de él, igual que
+    después de un EBREAK. Una instrucción no válida para en ella.
+*/
+
+#include "cpu.h"
+
+// Los compiladores GCC y Clang permiten guardar direcciones de etiquetas.
+// En el resto se usa un switch, que sigue siendo una tabla de saltos densa
+#if defined(__GNUC__) || defined(__clang__)
+#define THREADED_COMPUTED_GOTO
+#endif
+
+uint32_t CPU::runThreaded(uint32_t n){
+    return dispatchStats(stats, [this, n](auto policy) { return runThreadedWith<decltype(policy)>(n); });
+}
+
+template <class Stats>
+uint32_t CPU::runThreadedWith(uint32_t n){
+    if (n == 0)
+        return 0;
+
+    reg *const x = registers;
+    uint32_t pc = this->pc;
+    uint32_t cycles = this->cycles;
+    uint32_t remaining = n;
+
+    const PredecodedInst *inst;
+    PredecodedInst uncached;
+
+#ifdef THREADED_COMPUTED_GOTO
+    // Mismo orden que el enum Operation
+    static void *const dispatchTable[] = {
+        &&L_ADD, &&L_SUB, &&L_XOR, &&L_OR, &&L_AND, &&L_SLL, &&L_SRL, &&L_SRA, &&L_SLT, &&L_SLTU,
+        &&L_ADDI, &&L_XORI, &&L_ORI, &&L_ANDI,
+        &&L_SLLI, &&L_SRLI, &&L_SRAI, &&L_SLTI, &&L_SLTIU,
+        &&L_LB, &&L_LH, &&L_LW, &&L_LBU, &&L_LHU,
+        &&L_JALR,
+        &&L_ECALL, &&L_EBREAK,
+        &&L_SB, &&L_SH, &&L_SW,
+        &&L_BEQ, &&L_BNE, &&L_BLT, &&L_BGE, &&L_BLTU,
+        &&L_BGEU,
+        &&L_JAL,
+        &&L_LUI, &&L_AUIPC,
+        &&L_NOP
+    };
+#define CASE(name) L_##name:
+#define DISPATCH() goto *dispatchTable[inst->op]
+#else
+#define CASE(name) case Operation::name:
+#define DISPATCH() goto dispatch
+#endif
+
+    // Cuenta la instrucción y pasa a la siguiente, o sale si ya se han
+    // ejecutado todas las pedidas
+#define NEXT()                                          \
+    do {                                                \
+        cycles++;                                       \
+        if (--remaining == 0)                           \
+            goto end;                                   \
+        inst = fetchDecoded(pc, &uncached);             \
+        Stats::count(*this, pc, inst->op, inst->tipo);  \
+        DISPATCH();                                     \
+    } while (0)
+
+    // Después de un acceso a memoria: si ha tocado la dirección vigilada o
+    // se ha salido de la memoria se sale sin ejecutar la siguiente instrucción
+#define NEXT_MEM()                                      \
+    do {                                                \
+        if (ram->bWatchHit) {                           \
+            cycles++;                                   \
+            remaining--;                                \
+            goto end;                                   \
+        }                                               \
+        NEXT();                                         \
+    } while (0)
+
+#define RD  inst->rd
+#define RS1 inst->rs1
+#define RS2 inst->rs2
+#define IMM inst->inmediate
+
+    inst = fetchDecoded(pc, &uncached);
+    Stats::count(*this, pc, inst->op, inst->tipo);
+
+#ifdef THREADED_COMPUTED_GOTO
+    DISPATCH();
+#else
+dispatch:
+    switch (inst->op) {
+#endif
+
+    // R format
+    CASE(ADD)   x[RD] = x[RS1] + x[RS2]; pc += 4; NEXT();
+    CASE(SUB)   x[RD] = x[RS1] - x[RS2]; pc += 4; NEXT();
+    CASE(XOR)   x[RD] = x[RS1] ^ x[RS2]; pc += 4; NEXT();
+    CASE(OR)    x[RD] = x[RS1] | x[RS2]; pc += 4; NEXT();
+    CASE(AND)   x[RD] = x[RS1] & x[RS2]; pc += 4; NEXT();
+    CASE(SLL)   x[RD] = static_cast<uint32_t>(x[RS1]) << (x[RS2] & 0b11111); pc += 4; NEXT();
+    CASE(SRL)   x[RD] = static_cast<uint32_t>(x[RS1]) >> (x[RS2] & 0b11111); pc += 4; NEXT();
+    CASE(SRA)   x[RD] = x[RS1] >> (x[RS2] & 0b11111); pc += 4; NEXT();
+    CASE(SLT)   x[RD] = (x[RS1] < x[RS2]) ? 1 : 0; pc += 4; NEXT();
+    CASE(SLTU)  x[RD] = (static_cast<uint32_t>(x[RS1]) < static_cast<uint32_t>(x[RS2])) ? 1 : 0; pc += 4; NEXT();
+
+    // I format
+    CASE(ADDI)  x[RD] = x[RS1] + IMM; pc += 4; NEXT();
+    CASE(XORI)  x[RD] = x[RS1] ^ IMM; pc += 4; NEXT();
+    CASE(ORI)   x[RD] = x[RS1] | IMM; pc += 4; NEXT();
+    CASE(ANDI)  x[RD] = x[RS1] & IMM; pc += 4; NEXT();
+    CASE(SLLI)  x[RD] = static_cast<uint32_t>(x[RS1]) << (static_cast<uint32_t>(IMM) & 0b11111); pc += 4; NEXT();
+    CASE(SRLI)  x[RD] = static_cast<uint32_t>(x[RS1]) >> (static_cast<uint32_t>(IMM) & 0b11111); pc += 4; NEXT();
+    CASE(SRAI)  x[RD] = x[RS1] >> (IMM & 0b11111); pc += 4; NEXT();
+    CASE(SLTI)  x[RD] = (x[RS1] < IMM) ? 1 : 0; pc += 4; NEXT();
+    CASE(SLTIU) x[RD] = (static_cast<uint32_t>(x[RS1]) < static_cast<uint32_t>(IMM)) ? 1 : 0; pc += 4; NEXT();
+
+    CASE(LB)    x[RD] = static_cast<int8_t>(ram->readByte(x[RS1] + IMM)); pc += 4; NEXT_MEM();
+    CASE(LH)    x[RD] = static_cast<int16_t>(ram->readHalf(x[RS1] + IMM)); pc += 4; NEXT_MEM();
+    CASE(LW)    x[RD] = ram->readWord(x[RS1] + IMM); pc += 4; NEXT_MEM();
+    CASE(LBU)   x[RD] = ram->readByte(x[RS1] + IMM) & 0xFF; pc += 4; NEXT_MEM();
+    CASE(LHU)   x[RD] = ram->readHalf(x[RS1] + IMM); pc += 4; NEXT_MEM();
+
+    CASE(JALR) {
+        uint32_t target = x[RS1] + IMM;
+        if (RD != 0)
+            x[RD] = pc + 4;
+        pc = target;
+        NEXT();
+    }
+
+    CASE(ECALL)  pc += 4; NEXT();
+    CASE(EBREAK) bEbreak = true; pc += 4; cycles++; remaining--; goto end;
+
+    // S format
+    CASE(SB)    ram->writeByte(x[RS1] + IMM, x[RS2] & 0xFF); pc += 4; NEXT_MEM();
+    CASE(SH)    ram->writeHalf(x[RS1] + IMM, x[RS2] & 0xFFFF); pc += 4; NEXT_MEM();
+    CASE(SW)    ram->writeWord(x[RS1] + IMM, x[RS2]); pc += 4; NEXT_MEM();
+
+    // B format
+    CASE(BEQ)   pc += (x[RS1] == x[RS2]) ? IMM : 4; NEXT();
+    CASE(BNE)   pc += (x[RS1] != x[RS2]) ? IMM : 4; NEXT();
+    CASE(BLT)   pc += (x[RS1] < x[RS2]) ? IMM : 4; NEXT();
+    CASE(BGE)   pc += (x[RS1] >= x[RS2]) ? IMM : 4; NEXT();
+    CASE(BLTU)  pc += (static_cast<uint32_t>(x[RS1]) < static_cast<uint32_t>(x[RS2])) ? IMM : 4; NEXT();
+    CASE(BGEU)  pc += (static_cast<uint32_t>(x[RS1]) >= static_cast<uint32_t>(x[RS2])) ? IMM : 4; NEXT();
+
+    // J format
+    CASE(JAL)
+        if (RD != 0)
+            x[RD] = pc + 4;
+        pc += IMM;
+        NEXT();
+
+    // U format
+    CASE(LUI)   x[RD] = static_cast<uint32_t>(IMM) << 12; pc += 4; NEXT();
+    CASE(AUIPC) x[RD] = pc + (static_cast<uint32_t>(IMM) << 12); pc += 4; NEXT();
+
+    // Codificación no válida o FENCE. La excepción se cuenta como EBREAK,
+    // pero deja el PC en la instrucción
+    CASE(NOP)
+        if (illegalInstruction(pc)) {
+            cycles++;
+            remaining--;
+            goto end;
+        }
+        pc += 4;
+        NEXT();
+
+#ifndef THREADED_COMPUTED_GOTO
+    }
+#endif
+
+end:
+    // Se vuelca el estado local a la CPU
+    this->pc = pc;
+    this->cycles = cycles;
+    ir = inst->ir;
+
+    return n - remaining;
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef NEXT_MEM
+#undef RD
+#undef RS1
+#undef RS2
+#undef IMM
+}